@@ -0,0 +1,296 @@
+// Deterministic fly-through benchmark.
+//
+// Renders a fixed number of frames of the full pipeline (scene, bright pass,
+// bloom, post) offscreen while the camera follows a scripted orbit. Time only
+// advances by a fixed step, so every run renders exactly the same images and
+// runs can be compared. Results are printed as JSON:
+//
+//   OpenGLPrj_bench --frames 600 --width 1280 --height 720 > run.json
+//
+// cpu_ms   time spent submitting a frame on the CPU
+// gpu_ms   GL_TIME_ELAPSED sum over all passes of a frame
+// frame_ms time between frame starts, with at most two frames in flight
+// gl_state binds/uniform uploads per frame, issued vs skipped as redundant
+//
+// --compute-post runs bloom and grading as compute kernels (GL 4.3); the
+// kernel sizes can be swept with --compute-tile, --compute-radius and
+// --compute-group (see ComputePostSettings).
+//
+// Needs EGL (works on Mesa llvmpipe: LIBGL_ALWAYS_SOFTWARE=1).
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "HeadlessContext.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+namespace {
+
+const float kTimeStep = 1.0f / 60.0f;
+const int kFramesInFlight = 2;
+
+struct Options {
+    int frames = 600;
+    int warmup = 30;
+    int width  = 1280;
+    int height = 720;
+    bool gpuTerrain = false;
+    bool computePost = false;
+    ComputePostSettings compute;
+    std::string output; // empty = stdout
+};
+
+struct Stats {
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, min = 0.0, max = 0.0;
+};
+
+Stats summarize(std::vector<double> v)
+{
+    Stats s;
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < v.size(); i++) sum += v[i];
+    const size_t last = v.size() - 1;
+    s.mean = sum / (double)v.size();
+    s.p50 = v[std::min(last, (size_t)(0.50 * v.size()))];
+    s.p95 = v[std::min(last, (size_t)(0.95 * v.size()))];
+    s.p99 = v[std::min(last, (size_t)(0.99 * v.size()))];
+    s.min = v.front();
+    s.max = v.back();
+    return s;
+}
+
+void writeStats(std::ostream& os, const char* name, const Stats& s)
+{
+    os << "  \"" << name << "\": {\"mean\": " << s.mean << ", \"p50\": " << s.p50
+       << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99
+       << ", \"min\": " << s.min << ", \"max\": " << s.max << "}";
+}
+
+// Slow orbit around the valley with a gentle rise and fall, always looking at
+// the river. Pure function of time so every run sees the same frames.
+void flyThroughPose(float t, Camera& camera)
+{
+    const float angle  = 0.35f * t;
+    const float radius = 12.0f + 3.0f * std::sin(0.2f * t);
+    const glm::vec3 position(std::cos(angle) * radius, 3.0f + 1.5f * std::sin(0.5f * t), std::sin(angle) * radius);
+    const glm::vec3 target(0.0f, 0.5f, 0.0f);
+
+    glm::vec3 dir = glm::normalize(target - position);
+    float yaw   = glm::degrees(std::atan2(dir.z, dir.x));
+    float pitch = glm::degrees(std::asin(dir.y));
+    camera.setPose(position, yaw, pitch);
+}
+
+bool parseArgs(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--frames" && hasValue) {
+            opt.frames = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            opt.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--width" && hasValue) {
+            opt.width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            opt.height = std::atoi(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            opt.output = argv[++i];
+        } else if (arg == "--gpu-terrain") {
+            opt.gpuTerrain = true;
+        } else if (arg == "--compute-post") {
+            opt.computePost = true;
+        } else if (arg == "--compute-tile" && hasValue) {
+            opt.compute.blurTile = std::atoi(argv[++i]);
+        } else if (arg == "--compute-radius" && hasValue) {
+            opt.compute.blurRadius = std::atoi(argv[++i]);
+        } else if (arg == "--compute-group" && hasValue) {
+            opt.compute.groupSize = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--frames N] [--warmup N] [--width W] [--height H] [--gpu-terrain] [--output JSON]\n"
+                      << "       [--compute-post [--compute-tile N] [--compute-radius N] [--compute-group N]]\n";
+            return false;
+        }
+    }
+    if (opt.frames < 1 || opt.warmup < 0 || opt.width < 1 || opt.height < 1) {
+        std::cerr << "--frames, --width and --height must be positive\n";
+        return false;
+    }
+    return true;
+}
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return -1;
+
+    HeadlessContext context;
+    if (!context.create(opt.computePost ? 4 : 3, 3)) {
+        std::cerr << "Failed to create headless OpenGL context\n";
+        return -1;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress)) {
+        std::cerr << "Failed to initialize GLAD\n";
+        return -1;
+    }
+
+    Scene scene;
+    SceneSettings sceneSettings;
+    sceneSettings.terrain.gpuDisplacement = opt.gpuTerrain;
+    scene.init(sceneSettings);
+    scene.finishLoading(); // every run renders the final textures
+    Renderer renderer;
+    if (!renderer.init(opt.width, opt.height, true)) {
+        std::cerr << "Failed to create render targets\n";
+        return -1;
+    }
+    if (opt.computePost && !renderer.enableComputePost(opt.compute)) {
+        std::cerr << "Failed to build the compute post kernels\n";
+        return -1;
+    }
+
+    Camera camera(glm::vec3(0,0,3), glm::vec3(0,1,0), -90.0f, 0.0f);
+    PostSettings post;
+    GpuProfiler profiler;
+
+    std::vector<double> cpuMs, frameMs;
+    cpuMs.reserve(opt.frames);
+    frameMs.reserve(opt.frames);
+
+    // Stand-in for swap buffers: the CPU may run at most kFramesInFlight ahead
+    std::vector<GLsync> fences(kFramesInFlight, (GLsync)0);
+
+    const int total = opt.warmup + opt.frames;
+    std::chrono::steady_clock::time_point lastStart;
+    for (int frame = 0; frame < total; frame++) {
+        if (frame == opt.warmup) {
+            // Warm-up frames (shader compiles, first uploads) don't count
+            glFinish();
+            profiler.init(3, opt.frames);
+            GLState::resetCounters();
+        }
+
+        GLsync& fence = fences[frame % kFramesInFlight];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+            glDeleteSync(fence);
+            fence = 0;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (frame > opt.warmup) {
+            frameMs.push_back(std::chrono::duration<double, std::milli>(start - lastStart).count());
+        }
+        lastStart = start;
+
+        const float t = (float)frame * kTimeStep;
+        flyThroughPose(t, camera);
+        const float lightAngle = t;
+        glm::vec3 lightPos(std::cos(lightAngle) * 2.0f, 2.0f, std::sin(lightAngle) * 2.0f);
+
+        profiler.beginFrame();
+        renderer.renderFrame(scene, camera, lightPos, t, post, &profiler);
+        profiler.endFrame();
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        if (frame >= opt.warmup) cpuMs.push_back(msSince(start));
+    }
+    glFinish();
+    frameMs.push_back(msSince(lastStart)); // last frame, until drained
+    profiler.flush();
+
+    for (size_t i = 0; i < fences.size(); i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+    }
+
+    std::ofstream file;
+    if (!opt.output.empty()) {
+        file.open(opt.output.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Cannot write " << opt.output << "\n";
+            return -1;
+        }
+    }
+    std::ostream& os = opt.output.empty() ? std::cout : file;
+
+    const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+    std::string rendererName = glRenderer ? glRenderer : "unknown";
+    std::replace(rendererName.begin(), rendererName.end(), '"', '\'');
+
+    GpuProfiler::PassStats gpu = profiler.frameStats();
+
+    os << std::fixed << std::setprecision(3);
+    os << "{\n"
+       << "  \"benchmark\": \"flythrough\",\n"
+       << "  \"renderer\": \"" << rendererName << "\",\n"
+       << "  \"width\": " << opt.width << ",\n"
+       << "  \"height\": " << opt.height << ",\n"
+       << "  \"gpu_terrain\": " << (opt.gpuTerrain ? "true" : "false") << ",\n";
+    if (renderer.computePost()) {
+        // as used: out of range values are clamped
+        const ComputePostSettings& cs = renderer.computePostSettings();
+        os << "  \"compute_post\": {\"tile\": " << cs.blurTile << ", \"radius\": " << cs.blurRadius
+           << ", \"group\": " << cs.groupSize << "},\n";
+    } else {
+        os << "  \"compute_post\": null,\n";
+    }
+    os << "  \"frames\": " << opt.frames << ",\n"
+       << "  \"warmup\": " << opt.warmup << ",\n";
+    writeStats(os, "cpu_ms", summarize(cpuMs));
+    os << ",\n";
+    writeStats(os, "frame_ms", summarize(frameMs));
+    os << ",\n";
+    os << "  \"gpu_ms\": {\"mean\": " << gpu.avgMs << ", \"p50\": " << gpu.p50Ms
+       << ", \"p95\": " << gpu.p95Ms << ", \"p99\": " << gpu.p99Ms
+       << ", \"samples\": " << gpu.samples << "},\n";
+
+    std::vector<GpuProfiler::PassStats> passes = profiler.stats();
+    os << "  \"passes\": {";
+    for (size_t i = 0; i < passes.size(); i++) {
+        os << (i ? ", " : "") << "\"" << passes[i].name << "\": {\"mean\": " << passes[i].avgMs
+           << ", \"p50\": " << passes[i].p50Ms << ", \"p95\": " << passes[i].p95Ms
+           << ", \"p99\": " << passes[i].p99Ms << "}";
+    }
+    os << "},\n";
+
+    // Per measured frame: calls issued and skipped by the state cache
+    os << "  \"gl_state\": {";
+    for (int k = 0; k < GLState::KindCount; k++) {
+        const GLState::Counters& c = GLState::counters((GLState::Kind)k);
+        os << (k ? ", " : "") << "\"" << GLState::name((GLState::Kind)k) << "\": {\"issued\": "
+           << (double)c.issued / opt.frames << ", \"elided\": " << (double)c.elided / opt.frames << "}";
+    }
+    os << "}\n}\n";
+
+    profiler.destroy();
+    renderer.destroy();
+    scene.destroy();
+    context.destroy();
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Capture encoder benchmark: stb_image_write PNG (the old takeScreenshot path)
+// vs. the strip-parallel PNG writer vs. QOI, on a synthetic render-like image.
+//
+// Usage: OpenGLPrj_image_bench [width height [iterations]]
+// Prints one CSV row per encoder: encoder,width,height,threads,ms,bytes,roundtrip
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "ImageWriter.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// Smooth gradients, a few hard-edged blocks and a little noise: roughly what a
+// graded frame of the scene looks like to an entropy coder.
+static std::vector<unsigned char> makeImage(int w, int h)
+{
+    std::vector<unsigned char> px((size_t)w * h * 3);
+    unsigned int seed = 12345u;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            unsigned char* p = &px[((size_t)y * w + x) * 3];
+            float sky = (float)y / (float)h;
+            bool block = ((x / 90) + (y / 70)) % 5 == 0;
+            for (int c = 0; c < 3; c++) {
+                seed = seed * 1103515245u + 12345u;
+                float base = block ? 60.0f + 40.0f * c
+                                   : 255.0f * (0.35f + 0.4f * sky) * (0.6f + 0.15f * c)
+                                     + 20.0f * std::sin(x * 0.02f + c);
+                int v = (int)base + (int)((seed >> 16) % 5) - 2;
+                p[c] = (unsigned char)std::max(0, std::min(255, v));
+            }
+        }
+    }
+    return px;
+}
+
+static double timeMs(const std::function<void()>& fn, int iterations)
+{
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, ms);
+    }
+    return best;
+}
+
+static bool pngRoundTrip(const std::vector<unsigned char>& encoded, const std::vector<unsigned char>& pixels)
+{
+    int w = 0, h = 0, n = 0;
+    unsigned char* decoded = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &w, &h, &n, 3);
+    if (!decoded) return false;
+    bool same = std::memcmp(decoded, pixels.data(), pixels.size()) == 0;
+    stbi_image_free(decoded);
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    int w = argc > 2 ? std::atoi(argv[1]) : 1600;
+    int h = argc > 2 ? std::atoi(argv[2]) : 1200;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 5;
+    if (w <= 0 || h <= 0 || iterations <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [width height [iterations]]\n";
+        return 1;
+    }
+
+    std::vector<unsigned char> pixels = makeImage(w, h);
+    ImageView image;
+    image.pixels = pixels.data();
+    image.width = w;
+    image.height = h;
+    image.channels = 3;
+
+    const int cores = defaultThreadCount();
+    std::cout << "encoder,width,height,threads,ms,bytes,roundtrip\n";
+
+    {
+        int len = 0;
+        double ms = timeMs([&]() {
+            unsigned char* png = stbi_write_png_to_mem(pixels.data(), w * 3, w, h, 3, &len);
+            STBIW_FREE(png);
+        }, iterations);
+        std::cout << "stbi_png," << w << "," << h << ",1," << ms << "," << len << ",-\n";
+    }
+
+    std::vector<unsigned char> out;
+    int threadCounts[2] = { 1, cores };
+    for (int t = 0; t < (cores > 1 ? 2 : 1); t++) {
+        int threads = threadCounts[t];
+        double ms = timeMs([&]() { encodePng(image, out, threads); }, iterations);
+        std::cout << "strip_png," << w << "," << h << "," << threads << "," << ms << ","
+                  << out.size() << "," << (pngRoundTrip(out, pixels) ? "ok" : "FAIL") << "\n";
+    }
+
+    {
+        double ms = timeMs([&]() { encodeQoi(image, out); }, iterations);
+        std::cout << "qoi," << w << "," << h << ",1," << ms << "," << out.size() << ",-\n";
+    }
+    return 0;
+}
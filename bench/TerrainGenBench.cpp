@@ -0,0 +1,112 @@
+// Terrain grid generation: the original per-vertex Scene::init loop versus
+// Terrain::generateGrid (separable tables, SSE normals, rows across cores).
+//
+//   OpenGLPrj_terrain_bench [N ...]     (default 120 500 2000)
+//
+// Prints CSV: method,n,threads,ms,max_height_err,max_normal_err
+// Errors are against the original loop (heightAt + normalAt per vertex).
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "Parallel.h"
+#include "Terrain.h"
+
+namespace {
+
+const float kSize = 40.0f;
+
+// The ground loop as it was in Scene::init: 5 heightAt() per vertex, push_back per float
+std::vector<float> legacyGrid(int N)
+{
+    const float half = kSize * 0.5f;
+    std::vector<float> verts;
+    verts.reserve(N * N * 6);
+
+    for (int z = 0; z < N; z++) {
+        for (int x = 0; x < N; x++) {
+            float u = (float)x / (N - 1);
+            float v = (float)z / (N - 1);
+
+            float worldX = -half + u * kSize;
+            float worldZ = -half + v * kSize;
+
+            float y = Terrain::heightAt(worldX, worldZ);
+            glm::vec3 n = Terrain::normalAt(worldX, worldZ);
+
+            verts.push_back(worldX);
+            verts.push_back(y);
+            verts.push_back(worldZ);
+
+            verts.push_back(n.x);
+            verts.push_back(n.y);
+            verts.push_back(n.z);
+        }
+    }
+    return verts;
+}
+
+template <typename F>
+double bestMs(F fn, int runs)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, ms);
+    }
+    return best;
+}
+
+void compare(const std::vector<float>& ref, const std::vector<float>& got, double& heightErr, double& normalErr)
+{
+    heightErr = normalErr = 0.0;
+    for (size_t i = 0; i + 5 < ref.size(); i += 6) {
+        heightErr = std::max(heightErr, (double)std::fabs(ref[i + 1] - got[i + 1]));
+        for (int k = 3; k < 6; k++) normalErr = std::max(normalErr, (double)std::fabs(ref[i + k] - got[i + k]));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++) sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty()) {
+        sizes.push_back(120);
+        sizes.push_back(500);
+        sizes.push_back(2000);
+    }
+
+    std::cout << "method,n,threads,ms,max_height_err,max_normal_err\n";
+    for (size_t s = 0; s < sizes.size(); s++) {
+        const int N = sizes[s];
+        if (N < 2) continue;
+        const int runs = N >= 1000 ? 3 : 10;
+
+        std::vector<float> ref;
+        double ms = bestMs([&]() { ref = legacyGrid(N); }, runs);
+        std::cout << "legacy," << N << ",1," << ms << ",0,0\n";
+
+        const int threadCounts[2] = { 1, defaultThreadCount() };
+        for (int t = 0; t < 2; t++) {
+            if (t == 1 && threadCounts[1] == 1) break;
+            std::vector<float> out((size_t)N * N * 6);
+            const float step = kSize / (float)(N - 1);
+            ms = bestMs([&]() {
+                Terrain::generateGrid(-kSize * 0.5f, -kSize * 0.5f, step, N, out.data(), threadCounts[t]);
+            }, runs);
+
+            double heightErr, normalErr;
+            compare(ref, out, heightErr, normalErr);
+            std::cout << "generateGrid," << N << "," << threadCounts[t] << "," << ms << ","
+                      << heightErr << "," << normalErr << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Uniform upload cost: the string-keyed Shader::setXxx(name) path versus
+// handles resolved once with Shader::uniform<T>(), with raw glUniform* calls
+// on known locations as the floor.
+//
+//   OpenGLPrj_uniform_bench [draws]     (default 200000)
+//
+// Every "draw" sets what a scene draw sets: model matrix, color, material and
+// an instancing flag. The color never changes, so both Shader paths skip it
+// after the first draw (raw calls don't). Prints CSV: method,draws,ms,ns_per_set
+//
+// Needs EGL (works on Mesa llvmpipe: LIBGL_ALWAYS_SOFTWARE=1).
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+
+namespace {
+
+const char* const kVertexSrc = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 uModel;
+uniform vec3 uObjectColor;
+uniform int uMaterial;
+uniform bool uInstanced;
+out vec3 vColor;
+void main() {
+    vColor = uInstanced ? vec3(float(uMaterial)) : uObjectColor;
+    gl_Position = uModel * vec4(aPos, 1.0);
+}
+)";
+
+const char* const kFragmentSrc = R"(
+#version 330 core
+in vec3 vColor;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(vColor, 1.0);
+}
+)";
+
+// Uniforms set per draw
+const int kSetsPerDraw = 4;
+
+template <typename F>
+double bestMs(F fn, int runs)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        glFinish();
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, ms);
+    }
+    return best;
+}
+
+void report(const char* method, int draws, double ms)
+{
+    std::cout << method << "," << draws << "," << ms << ","
+              << ms * 1e6 / ((double)draws * kSetsPerDraw) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int draws = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200000;
+    const int runs = 5;
+
+    HeadlessContext context;
+    if (!context.create(3, 3)) {
+        std::cerr << "Failed to create headless OpenGL context\n";
+        return -1;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress)) {
+        std::cerr << "Failed to initialize GLAD\n";
+        return -1;
+    }
+
+    Shader shader(kVertexSrc, kFragmentSrc);
+    shader.use();
+
+    glm::mat4 model(1.0f);
+    const glm::vec3 color(0.3f, 0.6f, 0.2f);
+
+    std::cout << "method,draws,ms,ns_per_set\n";
+
+    double ms = bestMs([&]() {
+        for (int i = 0; i < draws; i++) {
+            model[3].x = (float)i;
+            shader.setMat4("uModel", model);
+            shader.setVec3("uObjectColor", color);
+            shader.setInt("uMaterial", i & 7);
+            shader.setInt("uInstanced", i & 1);
+        }
+    }, runs);
+    report("string", draws, ms);
+
+    ms = bestMs([&]() {
+        const Uniform<glm::mat4> modelU = shader.uniform<glm::mat4>("uModel");
+        const Uniform<glm::vec3> colorU = shader.uniform<glm::vec3>("uObjectColor");
+        const Uniform<int> materialU = shader.uniform<int>("uMaterial");
+        const Uniform<int> instancedU = shader.uniform<int>("uInstanced");
+        for (int i = 0; i < draws; i++) {
+            model[3].x = (float)i;
+            shader.set(modelU, model);
+            shader.set(colorU, color);
+            shader.set(materialU, i & 7);
+            shader.set(instancedU, i & 1);
+        }
+    }, runs);
+    report("handle", draws, ms);
+
+    const GLint modelLoc = glGetUniformLocation(shader.id(), "uModel");
+    const GLint colorLoc = glGetUniformLocation(shader.id(), "uObjectColor");
+    const GLint materialLoc = glGetUniformLocation(shader.id(), "uMaterial");
+    const GLint instancedLoc = glGetUniformLocation(shader.id(), "uInstanced");
+    ms = bestMs([&]() {
+        for (int i = 0; i < draws; i++) {
+            model[3].x = (float)i;
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &model[0][0]);
+            glUniform3f(colorLoc, color.x, color.y, color.z);
+            glUniform1i(materialLoc, i & 7);
+            glUniform1i(instancedLoc, i & 1);
+        }
+    }, runs);
+    report("raw", draws, ms);
+
+    return 0;
+}
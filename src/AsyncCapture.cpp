@@ -0,0 +1,220 @@
+#include "AsyncCapture.h"
+
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include "ImageWriter.h"
+#include "Trace.h"
+
+AsyncCapture::~AsyncCapture()
+{
+    destroy();
+}
+
+void AsyncCapture::init(int ringSize, size_t maxQueuedJobs)
+{
+    destroy();
+
+    m_slots.resize(ringSize > 0 ? ringSize : 1);
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        glGenBuffers(1, &m_slots[i].pbo);
+    }
+    m_next = 0;
+    m_maxJobs = maxQueuedJobs > 0 ? maxQueuedJobs : 1;
+    m_stop = false;
+    m_worker = std::thread(&AsyncCapture::workerLoop, this);
+}
+
+void AsyncCapture::destroy()
+{
+    if (m_slots.empty()) return;
+
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobReady.notify_all();
+    if (m_worker.joinable()) m_worker.join();
+
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        if (m_slots[i].pbo) glDeleteBuffers(1, &m_slots[i].pbo);
+    }
+    m_slots.clear();
+}
+
+void AsyncCapture::request(const std::string& filename, int width, int height)
+{
+    if (m_slots.empty() || width <= 0 || height <= 0) return;
+    TRACE_SCOPE("AsyncCapture::request");
+
+    Slot& slot = m_slots[m_next];
+    m_next = (m_next + 1) % m_slots.size();
+
+    // Ring is full: the oldest readback has had a few frames to land by now
+    if (slot.fence) retire(slot, true);
+
+    size_t bytes = (size_t)width * (size_t)height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (bytes > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+
+    // RGBA8 is the format drivers can DMA without a conversion pass
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.filename = filename;
+}
+
+void AsyncCapture::poll()
+{
+    // Retire in request order so files are written in the order they were taken
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot& slot = m_slots[(m_next + i) % m_slots.size()];
+        if (slot.fence && !retire(slot, false)) break;
+    }
+}
+
+void AsyncCapture::flush()
+{
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        Slot& slot = m_slots[(m_next + i) % m_slots.size()];
+        if (slot.fence) retire(slot, true);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_jobs.empty() || m_encoding > 0) {
+        m_jobDone.wait(lock);
+    }
+}
+
+int AsyncCapture::pending() const
+{
+    int inFlight = 0;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        if (m_slots[i].fence) inFlight++;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return inFlight + (int)m_jobs.size() + m_encoding;
+}
+
+bool AsyncCapture::retire(Slot& slot, bool wait)
+{
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(slot.fence, 0, 1000000000ull);
+    }
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        if (status == GL_WAIT_FAILED) {
+            std::cerr << "Capture: fence wait failed, dropping " << slot.filename << "\n";
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        return false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_jobs.size() >= m_maxJobs) {
+            if (!wait) return false;
+            while (m_jobs.size() >= m_maxJobs) m_jobDone.wait(lock);
+        }
+    }
+
+    TRACE_SCOPE("AsyncCapture::retire");
+    Job job;
+    job.width = slot.width;
+    job.height = slot.height;
+    job.filename = slot.filename;
+    job.pixels.resize((size_t)slot.width * (size_t)slot.height * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)job.pixels.size(), GL_MAP_READ_BIT);
+    if (src) {
+        std::memcpy(job.pixels.data(), src, job.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    if (!src) {
+        std::cerr << "Capture: failed to map readback buffer for " << slot.filename << "\n";
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobReady.notify_one();
+    return true;
+}
+
+void AsyncCapture::workerLoop()
+{
+    Trace::setThreadName("capture encoder");
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_jobs.empty() && !m_stop) m_jobReady.wait(lock);
+            if (m_jobs.empty()) return; // stopping and drained
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_encoding++;
+        }
+        // a slot in the queue just opened up
+        m_jobDone.notify_all();
+
+        encode(job);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_encoding--;
+        }
+        m_jobDone.notify_all();
+    }
+}
+
+void AsyncCapture::encode(const Job& job)
+{
+    TRACE_SCOPE("AsyncCapture::encode");
+    const int w = job.width;
+    const int h = job.height;
+
+    // GL rows are bottom-up: flip and drop alpha in one pass, a row at a time
+    std::vector<unsigned char> rgb((size_t)w * (size_t)h * 3);
+    for (int y = 0; y < h; y++) {
+        const unsigned char* src = &job.pixels[(size_t)(h - 1 - y) * w * 4];
+        unsigned char* dst = &rgb[(size_t)y * w * 3];
+        for (int x = 0; x < w; x++) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            src += 4;
+            dst += 3;
+        }
+    }
+
+    ImageView image;
+    image.pixels = rgb.data();
+    image.width = w;
+    image.height = h;
+    image.channels = 3;
+
+    // strip-parallel PNG, or QOI when the file name asks for it
+    if (writeImage(job.filename, image)) {
+        std::cout << "Screenshot saved: " << job.filename << "\n";
+    } else {
+        std::cerr << "Failed to write screenshot: " << job.filename << "\n";
+    }
+}
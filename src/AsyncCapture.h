@@ -0,0 +1,78 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Non-blocking framebuffer capture.
+//
+// request() starts a glReadPixels into one of a ring of pixel-pack buffers and
+// drops a fence behind it, so the call returns immediately. poll() (once per
+// frame) maps the buffers whose fence has signaled, usually one or two frames
+// later, and hands the pixels to a worker thread that flips the rows and
+// encodes the image (see ImageWriter.h). The render thread never waits on the
+// GPU or the encoder unless the ring and the bounded job queue are both full.
+class AsyncCapture {
+public:
+    AsyncCapture() = default;
+    ~AsyncCapture();
+
+    // Non-copyable (owns GL buffers and a thread)
+    AsyncCapture(const AsyncCapture&) = delete;
+    AsyncCapture& operator=(const AsyncCapture&) = delete;
+
+    // Needs a current GL context
+    void init(int ringSize = 3, size_t maxQueuedJobs = 4);
+    // Finishes all pending captures, then releases the buffers and the worker
+    void destroy();
+
+    // Queue a readback of the currently bound read framebuffer
+    void request(const std::string& filename, int width, int height);
+
+    // Moves finished readbacks to the encoder. Never blocks.
+    void poll();
+
+    // Blocks until every requested capture has been written to disk
+    void flush();
+
+    // Number of captures not written yet (in flight on the GPU or queued/encoding)
+    int pending() const;
+
+private:
+    struct Slot {
+        unsigned int pbo = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        std::string filename;
+    };
+
+    struct Job {
+        std::vector<unsigned char> pixels; // RGBA, bottom-up as read from GL
+        int width = 0;
+        int height = 0;
+        std::string filename;
+    };
+
+    // Copies a signaled slot into an encoder job. With wait=true it blocks on
+    // the fence and on queue space; otherwise it gives up and returns false.
+    bool retire(Slot& slot, bool wait);
+    void workerLoop();
+    static void encode(const Job& job);
+
+    std::vector<Slot> m_slots;
+    size_t m_next = 0;
+
+    std::thread m_worker;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_jobDone;
+    std::deque<Job> m_jobs;
+    size_t m_maxJobs = 4;
+    int m_encoding = 0;
+    bool m_stop = false;
+};
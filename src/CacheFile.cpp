@@ -0,0 +1,69 @@
+#include "CacheFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+uint64_t cacheHash(const void* bytes, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)bytes;
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void setCacheHeader(CacheFileHeader& header, const char* magic, uint32_t version, uint64_t hash)
+{
+    std::memcpy(header.magic, magic, 4);
+    header.version = version;
+    header.hash = hash;
+}
+
+bool cacheHeaderMatches(const CacheFileHeader& header, const char* magic, uint32_t version, uint64_t hash)
+{
+    return std::memcmp(header.magic, magic, 4) == 0 && header.version == version && header.hash == hash;
+}
+
+void makeCacheDirectory(const std::string& dir)
+{
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0777);
+#endif
+}
+
+bool writeCacheFile(const std::string& path, const FileChunk* chunks, int count)
+{
+    // The temp name is per thread, so concurrent writers don't share one
+    std::ostringstream tmp;
+    tmp << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    {
+        std::ofstream out(tmp.str().c_str(), std::ios::binary);
+        if (!out) return false;
+        for (int i = 0; i < count; i++) out.write((const char*)chunks[i].data, (std::streamsize)chunks[i].size);
+        if (!out) {
+            out.close();
+            std::remove(tmp.str().c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str()); // rename() doesn't replace on Windows
+    if (std::rename(tmp.str().c_str(), path.c_str()) != 0) {
+        std::remove(tmp.str().c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Pieces shared by the on-disk caches (TextureCache, ShaderCache).
+//
+// Every cache file starts with a CacheFileHeader: a tag naming the cache, its
+// layout version and the hash of what the entry was built from. Anything else
+// there (another cache's file, an old layout, a changed source) is a miss.
+// Files are written under a private temp name and renamed into place, so a
+// crash or a second writer never leaves a half-written file under the real
+// name.
+
+// FNV-1a, 64-bit
+uint64_t cacheHash(const void* bytes, size_t size);
+
+// Host byte order; each cache's own fields follow
+struct CacheFileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t hash;
+};
+
+void setCacheHeader(CacheFileHeader& header, const char* magic, uint32_t version, uint64_t hash);
+bool cacheHeaderMatches(const CacheFileHeader& header, const char* magic, uint32_t version, uint64_t hash);
+
+// Creates the cache directory if it is missing (one level)
+void makeCacheDirectory(const std::string& dir);
+
+// One piece of a file written by writeCacheFile()
+struct FileChunk {
+    const void* data;
+    size_t size;
+};
+
+// Writes the chunks back to back, through a temp file renamed over `path`.
+// Safe from several threads, also for the same path.
+bool writeCacheFile(const std::string& path, const FileChunk* chunks, int count);
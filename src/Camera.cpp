@@ -60,6 +60,21 @@ void Camera::processScroll(float yoffset) {
     if (m_fov > 90.0f) m_fov = 90.0f;
 }
 
+void Camera::setPose(const glm::vec3& position, float yawDeg, float pitchDeg) {
+    m_position = position;
+    m_yaw = yawDeg;
+    m_pitch = pitchDeg;
+    if (m_pitch > 89.0f)  m_pitch = 89.0f;
+    if (m_pitch < -89.0f) m_pitch = -89.0f;
+    updateVectors();
+}
+
+void Camera::setFov(float fovDeg) {
+    m_fov = fovDeg;
+    if (m_fov < 1.0f)  m_fov = 1.0f;
+    if (m_fov > 90.0f) m_fov = 90.0f;
+}
+
 void Camera::updateVectors() {
     glm::vec3 front;
     front.x = std::cos(glm::radians(m_yaw)) * std::cos(glm::radians(m_pitch));
@@ -25,6 +25,12 @@ public:
     const glm::vec3& front() const { return m_front; }
     const glm::vec3& up() const { return m_up; }
     float fov() const { return m_fov; }
+    float yaw() const { return m_yaw; }
+    float pitch() const { return m_pitch; }
+
+    // Absolute placement (scripted shots); pitch is clamped like mouse look
+    void setPose(const glm::vec3& position, float yawDeg, float pitchDeg);
+    void setFov(float fovDeg);
 
     // Settings
     void setMouseSensitivity(float s) { m_mouseSensitivity = s; }
@@ -0,0 +1,432 @@
+#include "CpuGrade.h"
+
+#include <algorithm>
+#include <cmath>
+#include "Parallel.h"
+#include "Trace.h"
+
+#if defined(__AVX2__)
+#define GRADE_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GRADE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Lane types: the kernels below are written once against these and
+// instantiated for the widest one available plus Scalar for row tails.
+struct Scalar {
+    static const int kWidth = 1;
+    float v;
+    static Scalar load(const float* p) { Scalar r; r.v = *p; return r; }
+    static Scalar set(float x) { Scalar r; r.v = x; return r; }
+    void store(float* p) const { *p = v; }
+};
+inline Scalar operator+(Scalar a, Scalar b) { return Scalar::set(a.v + b.v); }
+inline Scalar operator-(Scalar a, Scalar b) { return Scalar::set(a.v - b.v); }
+inline Scalar operator*(Scalar a, Scalar b) { return Scalar::set(a.v * b.v); }
+inline Scalar vmin(Scalar a, Scalar b) { return Scalar::set(std::min(a.v, b.v)); }
+inline Scalar vmax(Scalar a, Scalar b) { return Scalar::set(std::max(a.v, b.v)); }
+inline Scalar vsqrt(Scalar a) { return Scalar::set(std::sqrt(a.v)); }
+
+#if defined(GRADE_AVX2)
+struct Wide {
+    static const int kWidth = 8;
+    __m256 v;
+    static Wide load(const float* p) { Wide r; r.v = _mm256_loadu_ps(p); return r; }
+    static Wide set(float x) { Wide r; r.v = _mm256_set1_ps(x); return r; }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+inline Wide wide(__m256 v) { Wide r; r.v = v; return r; }
+inline Wide operator+(Wide a, Wide b) { return wide(_mm256_add_ps(a.v, b.v)); }
+inline Wide operator-(Wide a, Wide b) { return wide(_mm256_sub_ps(a.v, b.v)); }
+inline Wide operator*(Wide a, Wide b) { return wide(_mm256_mul_ps(a.v, b.v)); }
+inline Wide vmin(Wide a, Wide b) { return wide(_mm256_min_ps(a.v, b.v)); }
+inline Wide vmax(Wide a, Wide b) { return wide(_mm256_max_ps(a.v, b.v)); }
+inline Wide vsqrt(Wide a) { return wide(_mm256_sqrt_ps(a.v)); }
+#elif defined(GRADE_SSE)
+struct Wide {
+    static const int kWidth = 4;
+    __m128 v;
+    static Wide load(const float* p) { Wide r; r.v = _mm_loadu_ps(p); return r; }
+    static Wide set(float x) { Wide r; r.v = _mm_set1_ps(x); return r; }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline Wide wide(__m128 v) { Wide r; r.v = v; return r; }
+inline Wide operator+(Wide a, Wide b) { return wide(_mm_add_ps(a.v, b.v)); }
+inline Wide operator-(Wide a, Wide b) { return wide(_mm_sub_ps(a.v, b.v)); }
+inline Wide operator*(Wide a, Wide b) { return wide(_mm_mul_ps(a.v, b.v)); }
+inline Wide vmin(Wide a, Wide b) { return wide(_mm_min_ps(a.v, b.v)); }
+inline Wide vmax(Wide a, Wide b) { return wide(_mm_max_ps(a.v, b.v)); }
+inline Wide vsqrt(Wide a) { return wide(_mm_sqrt_ps(a.v)); }
+#else
+typedef Scalar Wide;
+#endif
+
+// PostSettings folded into what the kernels use per pixel
+struct GradeParams {
+    float exposureScale;
+    float brightness;
+    float contrast;
+    float saturation;
+    float vignette;
+    float vignetteStart;    // smoothstep edge0
+    float vignetteInvWidth; // 1 / (edge1 - edge0)
+    float bloomStrength;
+};
+
+// One channel per plane, row-major
+struct Planes {
+    int width = 0;
+    int height = 0;
+    std::vector<float> r, g, b;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        r.assign((size_t)w * h, 0.0f);
+        g.assign((size_t)w * h, 0.0f);
+        b.assign((size_t)w * h, 0.0f);
+    }
+    float* row(std::vector<float>& plane, int y) { return &plane[(size_t)y * width]; }
+};
+
+template <typename V>
+V clamp01(V x)
+{
+    return vmin(vmax(x, V::set(0.0f)), V::set(1.0f));
+}
+
+// Grade() over n pixels of planar color, in place. `vig` holds the vignette
+// distance term (u - 0.5)^2 per column, dv2 the row's (v - 0.5)^2. bloom may
+// be null. Processes whole lanes only: returns how many pixels were done.
+template <typename V>
+int gradeSpan(float* r, float* g, float* b, const float* br, const float* bg, const float* bb,
+              const float* vig, float dv2, int n, const GradeParams& p)
+{
+    const V exposure = V::set(p.exposureScale), brightness = V::set(p.brightness);
+    const V contrast = V::set(p.contrast), saturation = V::set(p.saturation), half = V::set(0.5f);
+    const V lr = V::set(0.2126f), lg = V::set(0.7152f), lb = V::set(0.0722f);
+    const V vignette = V::set(p.vignette), vigStart = V::set(p.vignetteStart);
+    const V vigInvWidth = V::set(p.vignetteInvWidth), rowDist = V::set(dv2);
+    const V one = V::set(1.0f), two = V::set(2.0f), three = V::set(3.0f);
+    const V strength = V::set(p.bloomStrength);
+
+    int x = 0;
+    for (; x + V::kWidth <= n; x += V::kWidth) {
+        V cr = V::load(r + x), cg = V::load(g + x), cb = V::load(b + x);
+
+        // exposure, brightness, contrast around 0.5
+        cr = ((cr * exposure + brightness) - half) * contrast + half;
+        cg = ((cg * exposure + brightness) - half) * contrast + half;
+        cb = ((cb * exposure + brightness) - half) * contrast + half;
+
+        // saturation: mix(luma, color, s)
+        const V luma = cr * lr + cg * lg + cb * lb;
+        cr = luma + (cr - luma) * saturation;
+        cg = luma + (cg - luma) * saturation;
+        cb = luma + (cb - luma) * saturation;
+
+        // vignette: smoothstep(0.707 - softness, 0.707, distance to center)
+        const V dist = vsqrt(V::load(vig + x) + rowDist);
+        const V t = clamp01((dist - vigStart) * vigInvWidth);
+        const V darken = one - vignette * (t * t * (three - two * t));
+        cr = cr * darken;
+        cg = cg * darken;
+        cb = cb * darken;
+
+        if (br) {
+            cr = cr + V::load(br + x) * strength;
+            cg = cg + V::load(bg + x) * strength;
+            cb = cb + V::load(bb + x) * strength;
+        }
+        clamp01(cr).store(r + x);
+        clamp01(cg).store(g + x);
+        clamp01(cb).store(b + x);
+    }
+    return x;
+}
+
+// dst[x] = sum of w[k] * (src[x - k] + src[x + k]); src must be readable from
+// -radius to n + radius. Whole lanes only, returns pixels done.
+template <typename V>
+int blurSpan(const float* src, float* dst, int n, const float* weights, int radius)
+{
+    int x = 0;
+    for (; x + V::kWidth <= n; x += V::kWidth) {
+        V sum = V::load(src + x) * V::set(weights[0]);
+        for (int k = 1; k <= radius; k++) {
+            sum = sum + (V::load(src + x - k) + V::load(src + x + k)) * V::set(weights[k]);
+        }
+        sum.store(dst + x);
+    }
+    return x;
+}
+
+// Same, down a column: rows[k] is the source row k - radius away, read from
+// column `first` on
+template <typename V>
+int blurColumns(const float* const* rows, int first, float* dst, int n, const float* weights, int radius)
+{
+    int x = 0;
+    for (; x + V::kWidth <= n; x += V::kWidth) {
+        const int c = first + x;
+        V sum = V::load(rows[radius] + c) * V::set(weights[0]);
+        for (int k = 1; k <= radius; k++) {
+            sum = sum + (V::load(rows[radius - k] + c) + V::load(rows[radius + k] + c)) * V::set(weights[k]);
+        }
+        sum.store(dst + x);
+    }
+    return x;
+}
+
+// a + (b - a) * t
+template <typename V>
+int lerpSpan(const float* a, const float* b, float t, float* dst, int n)
+{
+    const V vt = V::set(t);
+    int x = 0;
+    for (; x + V::kWidth <= n; x += V::kWidth) {
+        const V va = V::load(a + x);
+        (va + (V::load(b + x) - va) * vt).store(dst + x);
+    }
+    return x;
+}
+
+// Each kernel with the wide lanes, then the tail (or everything, without
+// simd) one pixel at a time
+void gradeRow(bool simd, float* r, float* g, float* b, const float* br, const float* bg, const float* bb,
+              const float* vig, float dv2, int n, const GradeParams& p)
+{
+    const int x = simd ? gradeSpan<Wide>(r, g, b, br, bg, bb, vig, dv2, n, p) : 0;
+    gradeSpan<Scalar>(r + x, g + x, b + x, br ? br + x : nullptr, bg + x, bb + x, vig + x, dv2, n - x, p);
+}
+
+void blurRow(bool simd, const float* src, float* dst, int n, const float* weights, int radius)
+{
+    const int x = simd ? blurSpan<Wide>(src, dst, n, weights, radius) : 0;
+    blurSpan<Scalar>(src + x, dst + x, n - x, weights, radius);
+}
+
+void blurColumnRow(bool simd, const float* const* rows, float* dst, int n, const float* weights, int radius)
+{
+    const int x = simd ? blurColumns<Wide>(rows, 0, dst, n, weights, radius) : 0;
+    blurColumns<Scalar>(rows, x, dst + x, n - x, weights, radius);
+}
+
+void lerpRow(bool simd, const float* a, const float* b, float t, float* dst, int n)
+{
+    const int x = simd ? lerpSpan<Wide>(a, b, t, dst, n) : 0;
+    lerpSpan<Scalar>(a + x, b + x, t, dst + x, n - x);
+}
+
+// Bilinear taps from a full resolution coordinate into a half resolution one,
+// at texel centers like GL_LINEAR
+struct Taps {
+    std::vector<int> i0, i1;
+    std::vector<float> t;
+
+    void build(int size, int halfSize) {
+        i0.resize(size);
+        i1.resize(size);
+        t.resize(size);
+        const float scale = (float)halfSize / (float)size;
+        for (int i = 0; i < size; i++) {
+            const float f = std::max(0.0f, ((float)i + 0.5f) * scale - 0.5f);
+            const int lo = std::min((int)f, halfSize - 1);
+            i0[i] = lo;
+            i1[i] = std::min(lo + 1, halfSize - 1);
+            t[i] = f - (float)lo;
+        }
+    }
+};
+
+float luminance(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Thresholded input at half resolution (the GPU's bright target, downsampled)
+void brightPass(const ImageView& image, float threshold, Planes& bright, int threads)
+{
+    TRACE_SCOPE("CpuGrade::brightPass");
+    const std::ptrdiff_t stride = image.stride ? image.stride : (std::ptrdiff_t)image.width * image.channels;
+    parallelFor(bright.height, [&](int y) {
+        float* r = bright.row(bright.r, y);
+        float* g = bright.row(bright.g, y);
+        float* b = bright.row(bright.b, y);
+        const int sy[2] = { std::min(2 * y, image.height - 1), std::min(2 * y + 1, image.height - 1) };
+        for (int x = 0; x < bright.width; x++) {
+            const int sx[2] = { std::min(2 * x, image.width - 1), std::min(2 * x + 1, image.width - 1) };
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            for (int j = 0; j < 2; j++) {
+                for (int i = 0; i < 2; i++) {
+                    const unsigned char* p = image.pixels + sy[j] * stride + sx[i] * image.channels;
+                    const float cr = p[0] / 255.0f, cg = p[1] / 255.0f, cb = p[2] / 255.0f;
+                    if (luminance(cr, cg, cb) > threshold) {
+                        sum[0] += cr;
+                        sum[1] += cg;
+                        sum[2] += cb;
+                    }
+                }
+            }
+            r[x] = sum[0] * 0.25f;
+            g[x] = sum[1] * 0.25f;
+            b[x] = sum[2] * 0.25f;
+        }
+    }, threads);
+}
+
+// Separable Gaussian, same weights as the compute path's blur kernel
+void blur(Planes& planes, int radius, const CpuGradeOptions& options)
+{
+    TRACE_SCOPE("CpuGrade::blur");
+    const float sigma = std::max(1.0f, radius / 3.0f);
+    std::vector<float> weights(radius + 1);
+    float norm = 0.0f;
+    for (int k = 0; k <= radius; k++) {
+        weights[k] = std::exp(-(float)(k * k) / (2.0f * sigma * sigma));
+        norm += k ? 2.0f * weights[k] : weights[k];
+    }
+    for (int k = 0; k <= radius; k++) weights[k] /= norm;
+
+    const int w = planes.width, h = planes.height;
+    std::vector<float>* channels[3] = { &planes.r, &planes.g, &planes.b };
+    std::vector<float> tmp((size_t)w * h);
+
+    for (int c = 0; c < 3; c++) {
+        std::vector<float>& plane = *channels[c];
+
+        // rows into tmp, through an edge-clamped copy of the row
+        parallelFor(h, [&](int y) {
+            std::vector<float> padded(w + 2 * radius);
+            const float* src = &plane[(size_t)y * w];
+            for (int i = 0; i < (int)padded.size(); i++) {
+                padded[i] = src[std::min(std::max(i - radius, 0), w - 1)];
+            }
+            blurRow(options.simd, &padded[radius], &tmp[(size_t)y * w], w, weights.data(), radius);
+        }, options.threads);
+
+        // columns back into the plane
+        parallelFor(h, [&](int y) {
+            std::vector<const float*> rows(2 * radius + 1);
+            for (int k = -radius; k <= radius; k++) {
+                rows[k + radius] = &tmp[(size_t)std::min(std::max(y + k, 0), h - 1) * w];
+            }
+            blurColumnRow(options.simd, rows.data(), &plane[(size_t)y * w], w, weights.data(), radius);
+        }, options.threads);
+    }
+}
+
+} // namespace
+
+const char* gradeSimdName()
+{
+#if defined(GRADE_AVX2)
+    return "avx2";
+#elif defined(GRADE_SSE)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+bool gradeImage(const ImageView& image, const PostSettings& post, const CpuGradeOptions& options,
+                std::vector<unsigned char>& out)
+{
+    TRACE_SCOPE("CpuGrade::gradeImage");
+    if (!image.pixels || image.width <= 0 || image.height <= 0) return false;
+    if (image.channels != 3 && image.channels != 4) return false;
+
+    const int w = image.width, h = image.height, channels = image.channels;
+    const std::ptrdiff_t stride = image.stride ? image.stride : (std::ptrdiff_t)w * channels;
+    out.resize((size_t)w * h * channels);
+
+    GradeParams params;
+    params.exposureScale = std::exp2(post.exposure);
+    params.brightness = post.brightness;
+    params.contrast = post.contrast;
+    params.saturation = post.saturation;
+    params.vignette = post.vignette;
+    params.vignetteStart = 0.707f - post.vignetteSoftness;
+    // softness 0 is undefined in GLSL; make it a step
+    params.vignetteInvWidth = post.vignetteSoftness > 0.0f ? 1.0f / post.vignetteSoftness : 1e30f;
+    params.bloomStrength = post.bloomStrength;
+
+    // Bloom at half resolution, like the renderer's bloom targets
+    Planes bloom;
+    Taps tapsX, tapsY;
+    if (post.bloomEnabled) {
+        bloom.resize(std::max(1, w >> 1), std::max(1, h >> 1));
+        brightPass(image, post.bloomThreshold, bloom, options.threads);
+        blur(bloom, std::max(1, options.bloomRadius), options);
+        tapsX.build(w, bloom.width);
+        tapsY.build(h, bloom.height);
+    }
+
+    // (u - 0.5)^2 per column, u at pixel centers like the post pass's vUV
+    std::vector<float> vig(w);
+    for (int x = 0; x < w; x++) {
+        const float du = ((float)x + 0.5f) / (float)w - 0.5f;
+        vig[x] = du * du;
+    }
+
+    TRACE_SCOPE("CpuGrade::tiles");
+    const int tilesX = (w + kGradeTileWidth - 1) / kGradeTileWidth;
+    const int tilesY = (h + kGradeTileHeight - 1) / kGradeTileHeight;
+    parallelFor(tilesX * tilesY, [&](int tile) {
+        const int x0 = (tile % tilesX) * kGradeTileWidth;
+        const int y0 = (tile / tilesX) * kGradeTileHeight;
+        const int n = std::min(kGradeTileWidth, w - x0);
+        const int y1 = std::min(y0 + kGradeTileHeight, h);
+
+        float r[kGradeTileWidth], g[kGradeTileWidth], b[kGradeTileWidth];
+        float br[kGradeTileWidth], bg[kGradeTileWidth], bb[kGradeTileWidth];
+        // half resolution bloom row, blended between its two source rows
+        std::vector<float> bloomRow[3];
+
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* src = image.pixels + y * stride + x0 * channels;
+            for (int x = 0; x < n; x++) {
+                r[x] = src[x * channels + 0] / 255.0f;
+                g[x] = src[x * channels + 1] / 255.0f;
+                b[x] = src[x * channels + 2] / 255.0f;
+            }
+
+            if (post.bloomEnabled) {
+                // half resolution columns this tile samples
+                const int h0 = tapsX.i0[x0], h1 = tapsX.i1[x0 + n - 1];
+                const int span = h1 - h0 + 1;
+                const float* rowsA[3] = { bloom.row(bloom.r, tapsY.i0[y]), bloom.row(bloom.g, tapsY.i0[y]),
+                                          bloom.row(bloom.b, tapsY.i0[y]) };
+                const float* rowsB[3] = { bloom.row(bloom.r, tapsY.i1[y]), bloom.row(bloom.g, tapsY.i1[y]),
+                                          bloom.row(bloom.b, tapsY.i1[y]) };
+                float* dst[3] = { br, bg, bb };
+                for (int c = 0; c < 3; c++) {
+                    bloomRow[c].resize(span);
+                    float* row = bloomRow[c].data();
+                    lerpRow(options.simd, rowsA[c] + h0, rowsB[c] + h0, tapsY.t[y], row, span);
+                    for (int x = 0; x < n; x++) {
+                        const int sx = x0 + x;
+                        const float lo = row[tapsX.i0[sx] - h0], hi = row[tapsX.i1[sx] - h0];
+                        dst[c][x] = lo + (hi - lo) * tapsX.t[sx];
+                    }
+                }
+            }
+
+            const float dv = ((float)y + 0.5f) / (float)h - 0.5f;
+            gradeRow(options.simd, r, g, b, post.bloomEnabled ? br : nullptr, bg, bb, &vig[x0], dv * dv, n, params);
+
+            unsigned char* dst = &out[((size_t)y * w + x0) * channels];
+            for (int x = 0; x < n; x++) {
+                dst[x * channels + 0] = (unsigned char)(r[x] * 255.0f + 0.5f);
+                dst[x * channels + 1] = (unsigned char)(g[x] * 255.0f + 0.5f);
+                dst[x * channels + 2] = (unsigned char)(b[x] * 255.0f + 0.5f);
+                if (channels == 4) dst[x * channels + 3] = src[x * channels + 3];
+            }
+        }
+    }, options.threads);
+    return true;
+}
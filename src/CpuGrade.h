@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "ImageWriter.h"
+#include "PostSettings.h"
+
+// The post shader's grading on the CPU, for images on disk (OpenGLPrj_grade).
+//
+// Same steps in the same order as Grade() in the post shader. 8-bit input is
+// read the way the GPU reads an RGBA8 texture (value / 255, no sRGB decode)
+// and written back rounded, like a UNORM render target. Bloom follows the
+// compute path (Renderer::enableComputePost): bright pass, 2x2 downsample,
+// one separable Gaussian at half resolution, bilinear upsample. The app's
+// default fragment path blooms through a pyramid instead, which spreads
+// wider, so graded images only match renders made with the compute path.
+// OpenGLPrj_grade_check compares both against the GPU.
+//
+// Work is split into kGradeTileWidth x kGradeTileHeight tiles spread over
+// every core. Each tile row is unpacked into planar floats (one array per
+// channel) and graded 8 (AVX2) or 4 (SSE) pixels at a time; the blur passes
+// are vectorized the same way across a row.
+const int kGradeTileWidth = 256;
+const int kGradeTileHeight = 32;
+
+struct CpuGradeOptions {
+    int bloomRadius = 16; // Gaussian taps each side, at half resolution
+    int threads = 0;      // 0 = every core
+    bool simd = true;     // false = one pixel at a time (the reference)
+};
+
+// Grades `image` (3 or 4 channels) into `out`, tightly packed with the same
+// channel count; alpha is copied. False on an empty or unsupported image.
+bool gradeImage(const ImageView& image, const PostSettings& post, const CpuGradeOptions& options,
+                std::vector<unsigned char>& out);
+
+// What gradeImage() runs with simd = true: "avx2", "sse" or "scalar"
+const char* gradeSimdName();
@@ -0,0 +1,172 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4& m)
+{
+    // Gribb/Hartmann: planes are sums/differences of the matrix rows.
+    // glm is column-major, m[col][row].
+    for (int i = 0; i < 4; i++) {
+        float r0 = m[i][0], r1 = m[i][1], r2 = m[i][2], r3 = m[i][3];
+        m_planes[0][i] = r3 + r0; // left
+        m_planes[1][i] = r3 - r0; // right
+        m_planes[2][i] = r3 + r1; // bottom
+        m_planes[3][i] = r3 - r1; // top
+        m_planes[4][i] = r3 + r2; // near
+        m_planes[5][i] = r3 - r2; // far
+    }
+}
+
+Frustum::Result Frustum::classify(const glm::vec3& c, const glm::vec3& e) const
+{
+    Result result = Inside;
+    for (int p = 0; p < 6; p++) {
+        const float* pl = m_planes[p];
+        float dist = pl[0] * c.x + pl[1] * c.y + pl[2] * c.z + pl[3];
+        float radius = std::fabs(pl[0]) * e.x + std::fabs(pl[1]) * e.y + std::fabs(pl[2]) * e.z;
+        if (dist < -radius) return Outside;
+        if (dist < radius) result = Intersecting;
+    }
+    return result;
+}
+
+void Frustum::testBoxes(const float* cx, const float* cy, const float* cz,
+                        const float* ex, const float* ey, const float* ez,
+                        int count, unsigned char* visible) const
+{
+    int i = 0;
+#ifdef CULLING_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 bcx = _mm_loadu_ps(cx + i), bcy = _mm_loadu_ps(cy + i), bcz = _mm_loadu_ps(cz + i);
+        __m128 bex = _mm_loadu_ps(ex + i), bey = _mm_loadu_ps(ey + i), bez = _mm_loadu_ps(ez + i);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const __m128 a = _mm_set1_ps(m_planes[p][0]);
+            const __m128 b = _mm_set1_ps(m_planes[p][1]);
+            const __m128 c = _mm_set1_ps(m_planes[p][2]);
+            const __m128 d = _mm_set1_ps(m_planes[p][3]);
+            // dist + radius < 0  ->  box entirely behind this plane
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, bcx), _mm_mul_ps(b, bcy)),
+                                     _mm_add_ps(_mm_mul_ps(c, bcz), d));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), bex),
+                                                  _mm_mul_ps(_mm_andnot_ps(signMask, b), bey)),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, c), bez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(outside);
+        visible[i + 0] = (mask & 1) ? 0 : 1;
+        visible[i + 1] = (mask & 2) ? 0 : 1;
+        visible[i + 2] = (mask & 4) ? 0 : 1;
+        visible[i + 3] = (mask & 8) ? 0 : 1;
+    }
+#endif
+    for (; i < count; i++) {
+        Result r = classify(glm::vec3(cx[i], cy[i], cz[i]), glm::vec3(ex[i], ey[i], ez[i]));
+        visible[i] = (r != Outside) ? 1 : 0;
+    }
+}
+
+void CullGrid::clear()
+{
+    m_cells.clear();
+    m_items.clear();
+    m_cx.clear(); m_cy.clear(); m_cz.clear();
+    m_ex.clear(); m_ey.clear(); m_ez.clear();
+}
+
+void CullGrid::build(const std::vector<Aabb>& boxes, float cellSize)
+{
+    clear();
+    if (boxes.empty() || cellSize <= 0.0f) return;
+
+    // Grid over the XZ footprint of all items
+    float minX = boxes[0].min.x, maxX = boxes[0].max.x;
+    float minZ = boxes[0].min.z, maxZ = boxes[0].max.z;
+    for (size_t i = 1; i < boxes.size(); i++) {
+        minX = std::min(minX, boxes[i].min.x); maxX = std::max(maxX, boxes[i].max.x);
+        minZ = std::min(minZ, boxes[i].min.z); maxZ = std::max(maxZ, boxes[i].max.z);
+    }
+    const int gw = std::max(1, (int)std::ceil((maxX - minX) / cellSize));
+    const int gh = std::max(1, (int)std::ceil((maxZ - minZ) / cellSize));
+
+    // Counting sort of items by cell
+    std::vector<unsigned int> cellOf(boxes.size());
+    std::vector<unsigned int> start((size_t)gw * gh + 1, 0);
+    for (size_t i = 0; i < boxes.size(); i++) {
+        float x = (boxes[i].min.x + boxes[i].max.x) * 0.5f;
+        float z = (boxes[i].min.z + boxes[i].max.z) * 0.5f;
+        int gx = std::min(gw - 1, std::max(0, (int)((x - minX) / cellSize)));
+        int gz = std::min(gh - 1, std::max(0, (int)((z - minZ) / cellSize)));
+        cellOf[i] = (unsigned int)(gz * gw + gx);
+        start[cellOf[i] + 1]++;
+    }
+    for (size_t c = 1; c < start.size(); c++) start[c] += start[c - 1];
+
+    m_items.resize(boxes.size());
+    std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < boxes.size(); i++) m_items[fill[cellOf[i]]++] = (unsigned int)i;
+
+    const size_t n = m_items.size();
+    m_cx.resize(n); m_cy.resize(n); m_cz.resize(n);
+    m_ex.resize(n); m_ey.resize(n); m_ez.resize(n);
+
+    for (size_t c = 0; c + 1 < start.size(); c++) {
+        if (start[c] == start[c + 1]) continue;
+
+        // Cell bounds = union of its items (items may stick out of the cell)
+        glm::vec3 lo = boxes[m_items[start[c]]].min, hi = boxes[m_items[start[c]]].max;
+        for (unsigned int k = start[c]; k < start[c + 1]; k++) {
+            const Aabb& b = boxes[m_items[k]];
+            lo = glm::min(lo, b.min);
+            hi = glm::max(hi, b.max);
+            m_cx[k] = (b.min.x + b.max.x) * 0.5f; m_ex[k] = (b.max.x - b.min.x) * 0.5f;
+            m_cy[k] = (b.min.y + b.max.y) * 0.5f; m_ey[k] = (b.max.y - b.min.y) * 0.5f;
+            m_cz[k] = (b.min.z + b.max.z) * 0.5f; m_ez[k] = (b.max.z - b.min.z) * 0.5f;
+        }
+
+        Cell cell;
+        cell.center = (lo + hi) * 0.5f;
+        cell.extent = (hi - lo) * 0.5f;
+        cell.first = start[c];
+        cell.count = start[c + 1] - start[c];
+        m_cells.push_back(cell);
+    }
+}
+
+void CullGrid::query(const Frustum& frustum, std::vector<unsigned int>& visible, Stats& stats) const
+{
+    for (size_t c = 0; c < m_cells.size(); c++) {
+        const Cell& cell = m_cells[c];
+        Frustum::Result r = frustum.classify(cell.center, cell.extent);
+        if (r == Frustum::Outside) {
+            stats.culled += (int)cell.count;
+            continue;
+        }
+        if (r == Frustum::Inside) {
+            visible.insert(visible.end(), m_items.begin() + cell.first, m_items.begin() + cell.first + cell.count);
+            stats.visible += (int)cell.count;
+            continue;
+        }
+
+        stats.cellsVisited++;
+        m_scratch.resize(cell.count);
+        const unsigned int f = cell.first;
+        frustum.testBoxes(&m_cx[f], &m_cy[f], &m_cz[f], &m_ex[f], &m_ey[f], &m_ez[f],
+                          (int)cell.count, m_scratch.data());
+        for (unsigned int k = 0; k < cell.count; k++) {
+            if (m_scratch[k]) {
+                visible.push_back(m_items[f + k]);
+                stats.visible++;
+            } else {
+                stats.culled++;
+            }
+        }
+    }
+}
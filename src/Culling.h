@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// View frustum as 6 planes (ax + by + cz + d >= 0 inside), taken straight
+// from a projection * view matrix.
+class Frustum {
+public:
+    enum Result { Outside, Intersecting, Inside };
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProj);
+
+    Result classify(const glm::vec3& center, const glm::vec3& extent) const;
+
+    // Tests boxes given as center/extent arrays (structure of arrays) and
+    // writes 1 (at least partly inside) or 0 per box. Uses SSE when
+    // available, 4 boxes per step.
+    void testBoxes(const float* cx, const float* cy, const float* cz,
+                   const float* ex, const float* ey, const float* ez,
+                   int count, unsigned char* visible) const;
+
+private:
+    float m_planes[6][4] = {};
+};
+
+// Uniform grid over the XZ plane for frustum queries. Cells are culled as a
+// whole first; only the items of cells cut by the frustum are tested one by
+// one. Items are stored sorted by cell so those tests stream through memory.
+class CullGrid {
+public:
+    struct Stats {
+        int visible = 0;
+        int culled = 0;
+        int cellsVisited = 0;
+    };
+
+    void build(const std::vector<Aabb>& boxes, float cellSize);
+    void clear();
+
+    // Appends the indices (into the boxes given to build) of visible items
+    void query(const Frustum& frustum, std::vector<unsigned int>& visible, Stats& stats) const;
+
+    size_t size() const { return m_items.size(); }
+
+private:
+    struct Cell {
+        glm::vec3 center;
+        glm::vec3 extent;
+        unsigned int first = 0;
+        unsigned int count = 0;
+    };
+
+    std::vector<Cell> m_cells;          // non-empty cells only
+    std::vector<unsigned int> m_items;  // item indices, grouped by cell
+
+    // Item bounds (center/extent) in m_items order
+    std::vector<float> m_cx, m_cy, m_cz, m_ex, m_ey, m_ez;
+    mutable std::vector<unsigned char> m_scratch;
+};
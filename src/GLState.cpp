@@ -0,0 +1,159 @@
+#include "GLState.h"
+
+#include <glad/glad.h>
+
+namespace {
+
+// Nothing known about a binding: the next call always goes through
+const unsigned int kUnknown = ~0u;
+
+const int kMaxUnits = 16;
+
+// Shadowed texture targets; others always go through
+enum TargetSlot { Slot2D, Slot2DArray, SlotCount };
+
+int targetSlot(unsigned int target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:       return Slot2D;
+    case GL_TEXTURE_2D_ARRAY: return Slot2DArray;
+    default:                  return -1;
+    }
+}
+
+unsigned int g_program = kUnknown;
+unsigned int g_vao = kUnknown;
+unsigned int g_activeUnit = kUnknown;
+unsigned int g_textures[kMaxUnits][SlotCount];
+bool g_texturesKnown = false;
+
+void forgetTextures()
+{
+    for (int u = 0; u < kMaxUnits; u++) {
+        for (int s = 0; s < SlotCount; s++) g_textures[u][s] = kUnknown;
+    }
+    g_texturesKnown = true;
+}
+
+} // namespace
+
+GLState::Counters GLState::s_counters[GLState::KindCount];
+
+void GLState::useProgram(unsigned int program)
+{
+    const bool elided = program == g_program;
+    count(ProgramBinds, elided);
+    if (elided) return;
+    glUseProgram(program);
+    g_program = program;
+}
+
+unsigned int GLState::program()
+{
+    return g_program;
+}
+
+void GLState::bindVertexArray(unsigned int vao)
+{
+    const bool elided = vao == g_vao;
+    count(VertexArrayBinds, elided);
+    if (elided) return;
+    glBindVertexArray(vao);
+    g_vao = vao;
+}
+
+void GLState::activeTexture(unsigned int unit)
+{
+    const bool elided = unit == g_activeUnit;
+    count(ActiveTextureCalls, elided);
+    if (elided) return;
+    glActiveTexture(unit);
+    g_activeUnit = unit;
+}
+
+void GLState::bindTexture(unsigned int target, unsigned int texture)
+{
+    if (!g_texturesKnown) forgetTextures();
+
+    const int slot = targetSlot(target);
+    const int unit = g_activeUnit == kUnknown ? -1 : (int)(g_activeUnit - GL_TEXTURE0);
+    if (slot < 0 || unit < 0 || unit >= kMaxUnits) {
+        count(TextureBinds, false);
+        glBindTexture(target, texture);
+        // the unit is unknown, so any of them may have changed
+        if (unit < 0 && slot >= 0) {
+            for (int u = 0; u < kMaxUnits; u++) g_textures[u][slot] = kUnknown;
+        }
+        return;
+    }
+
+    unsigned int& bound = g_textures[unit][slot];
+    const bool elided = texture == bound;
+    count(TextureBinds, elided);
+    if (elided) return;
+    glBindTexture(target, texture);
+    bound = texture;
+}
+
+void GLState::deleteProgram(unsigned int program)
+{
+    if (program == g_program) g_program = kUnknown;
+    glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArrays(int n, const unsigned int* vaos)
+{
+    for (int i = 0; i < n; i++) {
+        if (vaos[i] == g_vao) g_vao = kUnknown;
+    }
+    glDeleteVertexArrays(n, vaos);
+}
+
+void GLState::deleteTextures(int n, const unsigned int* textures)
+{
+    if (g_texturesKnown) {
+        for (int i = 0; i < n; i++) {
+            for (int u = 0; u < kMaxUnits; u++) {
+                for (int s = 0; s < SlotCount; s++) {
+                    if (g_textures[u][s] == textures[i]) g_textures[u][s] = kUnknown;
+                }
+            }
+        }
+    }
+    glDeleteTextures(n, textures);
+}
+
+void GLState::invalidate()
+{
+    g_program = kUnknown;
+    g_vao = kUnknown;
+    g_activeUnit = kUnknown;
+    g_texturesKnown = false;
+}
+
+void GLState::resetCounters()
+{
+    for (int k = 0; k < KindCount; k++) s_counters[k] = Counters();
+}
+
+const char* GLState::name(Kind kind)
+{
+    switch (kind) {
+    case ProgramBinds:       return "program";
+    case VertexArrayBinds:   return "vao";
+    case ActiveTextureCalls: return "active_texture";
+    case TextureBinds:       return "texture";
+    case UniformUploads:     return "uniform";
+    default:                 return "?";
+    }
+}
+
+void GLState::print(std::ostream& os)
+{
+    os << "gl state elided:";
+    for (int k = 0; k < KindCount; k++) {
+        const Counters& c = s_counters[k];
+        os << " " << name((Kind)k) << "=" << c.elided << "/" << c.issued + c.elided;
+    }
+    os << "\n";
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+// Shadow of the GL bindings the render loop changes most: program, vertex
+// array, active texture unit and the 2D / 2D array texture on each unit.
+// Calls that would set what is already bound are skipped. Shader keeps the
+// matching shadow of uniform values per program and reports through
+// countUniform().
+//
+// The shadow is only right if every bind goes through here, and an object
+// must be deleted through here too (GL unbinds it and may hand its name out
+// again). One context, GL thread only.
+class GLState {
+public:
+    enum Kind { ProgramBinds, VertexArrayBinds, ActiveTextureCalls, TextureBinds, UniformUploads, KindCount };
+
+    struct Counters {
+        uint64_t issued = 0;
+        uint64_t elided = 0;
+    };
+
+    static void useProgram(unsigned int program);
+    // What useProgram() last bound; ~0u when unknown
+    static unsigned int program();
+    static void bindVertexArray(unsigned int vao);
+    // unit as in glActiveTexture: GL_TEXTURE0 + n
+    static void activeTexture(unsigned int unit);
+    // On the active unit
+    static void bindTexture(unsigned int target, unsigned int texture);
+
+    static void deleteProgram(unsigned int program);
+    static void deleteVertexArrays(int n, const unsigned int* vaos);
+    static void deleteTextures(int n, const unsigned int* textures);
+
+    // Forget every binding (after raw GL calls or on a new context)
+    static void invalidate();
+
+    static void countUniform(bool elided) { count(UniformUploads, elided); }
+
+    static const Counters& counters(Kind kind) { return s_counters[kind]; }
+    static void resetCounters();
+    static const char* name(Kind kind);
+    // "gl state elided: program=12/40 vao=..." (elided/total) on one line
+    static void print(std::ostream& os);
+
+private:
+    static void count(Kind kind, bool elided) {
+        if (elided) s_counters[kind].elided++;
+        else s_counters[kind].issued++;
+    }
+
+    static Counters s_counters[KindCount];
+};
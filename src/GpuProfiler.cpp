@@ -0,0 +1,215 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+
+GpuProfiler::~GpuProfiler()
+{
+    destroy();
+}
+
+void GpuProfiler::init(int framesInFlight, int history)
+{
+    destroy();
+    m_frames.resize(framesInFlight > 1 ? framesInFlight : 2);
+    m_history = history > 0 ? (size_t)history : 1;
+    m_frameTotals = PassHistory();
+    m_frameTotals.name = "frame";
+    m_frameTotals.samples.resize(m_history);
+    m_frameCounter = 0;
+}
+
+void GpuProfiler::destroy()
+{
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        if (!m_frames[i].queries.empty())
+            glDeleteQueries((GLsizei)m_frames[i].queries.size(), m_frames[i].queries.data());
+    }
+    m_frames.clear();
+    m_passes.clear();
+    m_frameTotals.count = m_frameTotals.next = 0;
+    m_inPass = m_inFrame = false;
+    if (m_csv.is_open()) m_csv.close();
+}
+
+bool GpuProfiler::openCsv(const std::string& path)
+{
+    m_csv.open(path.c_str());
+    if (!m_csv.is_open()) return false;
+    m_csv << "frame,pass,gpu_ms\n";
+    return true;
+}
+
+int GpuProfiler::passIndex(const char* name)
+{
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].name == name) return (int)i;
+    }
+    PassHistory p;
+    p.name = name;
+    p.samples.resize(m_history);
+    m_passes.push_back(p);
+    return (int)m_passes.size() - 1;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (m_frames.empty()) return;
+
+    // The slot we're about to reuse is the oldest one; its results are needed
+    // now. Younger frames are picked up too if the GPU already got to them.
+    const size_t n = m_frames.size();
+    const size_t slot = (size_t)(m_frameCounter % (long long)n);
+    for (size_t i = 0; i < n; i++) {
+        if (!collect(m_frames[(slot + i) % n], i == 0)) break;
+    }
+
+    FrameQueries& fq = m_frames[slot];
+    fq.used = 0;
+    fq.frame = m_frameCounter;
+    m_current = slot;
+    m_inFrame = true;
+}
+
+void GpuProfiler::begin(const char* pass)
+{
+    if (!m_inFrame) return;
+    if (m_inPass) end();
+
+    FrameQueries& fq = m_frames[m_current];
+    if (fq.used == (int)fq.queries.size()) {
+        GLuint q = 0;
+        glGenQueries(1, &q);
+        fq.queries.push_back(q);
+        fq.passes.push_back(0);
+    }
+    fq.passes[fq.used] = passIndex(pass);
+    glBeginQuery(GL_TIME_ELAPSED, fq.queries[fq.used]);
+    fq.used++;
+    m_inPass = true;
+}
+
+void GpuProfiler::end()
+{
+    if (!m_inPass) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_inPass = false;
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!m_inFrame) return;
+    end();
+    m_inFrame = false;
+    m_frameCounter++;
+}
+
+void GpuProfiler::flush()
+{
+    const size_t n = m_frames.size();
+    const size_t oldest = (size_t)(m_frameCounter % (long long)(n ? n : 1));
+    for (size_t i = 0; i < n; i++) collect(m_frames[(oldest + i) % n], true);
+}
+
+bool GpuProfiler::collect(FrameQueries& fq, bool wait)
+{
+    if (fq.frame < 0) return true;
+    if (fq.used == 0) {
+        fq.frame = -1;
+        return true;
+    }
+
+    // Queries finish in submission order, so the last one decides for all
+    if (!wait) {
+        GLint available = 0;
+        glGetQueryObjectiv(fq.queries[fq.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return false;
+    }
+
+    // A pass may be issued more than once per frame; report the frame total
+    std::vector<double> perPass(m_passes.size(), -1.0);
+    for (int i = 0; i < fq.used; i++) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(fq.queries[i], GL_QUERY_RESULT, &ns);
+        double& ms = perPass[fq.passes[i]];
+        ms = (ms < 0.0 ? 0.0 : ms) + (double)ns / 1.0e6;
+    }
+
+    double total = 0.0;
+    for (size_t p = 0; p < perPass.size(); p++) {
+        if (perPass[p] < 0.0) continue;
+        PassHistory& h = m_passes[p];
+        push(h, (float)perPass[p]);
+        total += perPass[p];
+
+        if (m_csv.is_open()) {
+            m_csv << fq.frame << "," << h.name << "," << perPass[p] << "\n";
+        }
+    }
+
+    push(m_frameTotals, (float)total);
+
+    fq.frame = -1;
+    fq.used = 0;
+    return true;
+}
+
+void GpuProfiler::push(PassHistory& h, float ms)
+{
+    if (h.samples.empty()) return;
+    h.samples[h.next] = ms;
+    h.next = (h.next + 1) % h.samples.size();
+    if (h.count < h.samples.size()) h.count++;
+}
+
+GpuProfiler::PassStats GpuProfiler::summarize(const PassHistory& h)
+{
+    PassStats s;
+    s.name = h.name;
+    s.samples = (int)h.count;
+    if (h.count > 0) {
+        std::vector<float> sorted(h.samples.begin(), h.samples.begin() + h.count);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++) sum += sorted[i];
+        s.avgMs = sum / (double)sorted.size();
+
+        const size_t last = sorted.size() - 1;
+        s.p50Ms = sorted[std::min(last, (size_t)(0.50 * sorted.size()))];
+        s.p95Ms = sorted[std::min(last, (size_t)(0.95 * sorted.size()))];
+        s.p99Ms = sorted[std::min(last, (size_t)(0.99 * sorted.size()))];
+    }
+    return s;
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::stats() const
+{
+    std::vector<PassStats> out;
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        out.push_back(summarize(m_passes[p]));
+    }
+    return out;
+}
+
+GpuProfiler::PassStats GpuProfiler::frameStats() const
+{
+    return summarize(m_frameTotals);
+}
+
+void GpuProfiler::print(std::ostream& os) const
+{
+    std::vector<PassStats> all = stats();
+    double total = 0.0;
+
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(2) << "gpu ms (avg/p50/p95/p99):";
+    for (size_t i = 0; i < all.size(); i++) {
+        os << " " << all[i].name << " " << all[i].avgMs << "/" << all[i].p50Ms
+           << "/" << all[i].p95Ms << "/" << all[i].p99Ms;
+        total += all[i].avgMs;
+    }
+    os << " | total " << total << "\n";
+    os.flags(flags);
+    os.precision(precision);
+}
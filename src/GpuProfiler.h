@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+
+// Per-pass GPU timings with GL_TIME_ELAPSED queries.
+//
+// Each frame gets its own set of queries from a small ring. A frame's results
+// are only read once the driver reports them available (a frame or two
+// later), so timing never stalls the pipeline. Passes can't nest: TIME_ELAPSED
+// queries are one-at-a-time in GL.
+class GpuProfiler {
+public:
+    struct PassStats {
+        std::string name;
+        double avgMs = 0.0;
+        double p50Ms = 0.0;
+        double p95Ms = 0.0;
+        double p99Ms = 0.0;
+        int samples = 0;
+    };
+
+    GpuProfiler() = default;
+    ~GpuProfiler();
+
+    // Non-copyable (owns GL query objects)
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // framesInFlight: query sets in the ring; history: samples kept per pass
+    void init(int framesInFlight = 3, int history = 240);
+    void destroy();
+
+    // Streams "frame,pass,gpu_ms" rows as results arrive
+    bool openCsv(const std::string& path);
+
+    void beginFrame();
+    void begin(const char* pass);
+    void end();
+    void endFrame();
+
+    // Blocks until all issued queries are resolved (use before final stats)
+    void flush();
+
+    std::vector<PassStats> stats() const;
+    // Sum of all passes per frame, named "frame"
+    PassStats frameStats() const;
+    // One line: avg/p50/p95/p99 ms per pass and the summed average
+    void print(std::ostream& os) const;
+
+private:
+    struct FrameQueries {
+        std::vector<GLuint> queries;
+        std::vector<int> passes;   // pass index of each used query
+        int used = 0;
+        long long frame = -1;      // -1 = nothing pending
+    };
+
+    struct PassHistory {
+        std::string name;
+        std::vector<float> samples; // ring buffer of ms
+        size_t next = 0;
+        size_t count = 0;
+    };
+
+    int passIndex(const char* name);
+    bool collect(FrameQueries& fq, bool wait);
+    static void push(PassHistory& h, float ms);
+    static PassStats summarize(const PassHistory& h);
+
+    std::vector<FrameQueries> m_frames;
+    std::vector<PassHistory> m_passes;
+    PassHistory m_frameTotals;
+    size_t m_current = 0;
+    size_t m_history = 240;
+    long long m_frameCounter = 0;
+    bool m_inPass = false;
+    bool m_inFrame = false;
+    std::ofstream m_csv;
+};
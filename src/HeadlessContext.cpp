@@ -0,0 +1,156 @@
+#include "HeadlessContext.h"
+
+#include <iostream>
+#include <cstring>
+
+#ifdef OPENGLPRJ_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static bool hasExtension(const char* list, const char* name)
+{
+    if (!list) return false;
+    const size_t len = std::strlen(name);
+    const char* p = list;
+    while ((p = std::strstr(p, name)) != nullptr) {
+        // make sure we matched a whole token, not a prefix of a longer name
+        if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+            return true;
+        p += len;
+    }
+    return false;
+}
+
+static EGLDisplay openDisplay()
+{
+    // Prefer the surfaceless platform: no X11/Wayland/GBM device needed at all.
+    const char* clientExts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay && hasExtension(clientExts, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (dpy != EGL_NO_DISPLAY) return dpy;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool HeadlessContext::create(int majorVersion, int minorVersion)
+{
+    destroy();
+
+    EGLDisplay dpy = openDisplay();
+    EGLint eglMajor = 0, eglMinor = 0;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &eglMajor, &eglMinor)) {
+        std::cerr << "EGL: failed to initialize display\n";
+        return false;
+    }
+    m_display = dpy;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL: desktop OpenGL API not available\n";
+        destroy();
+        return false;
+    }
+
+    // We never draw to the EGL surface (everything goes through FBOs), so the
+    // config only has to be GL-renderable. Ask for pbuffer support first and
+    // fall back to "any surface type" for drivers that only do surfaceless.
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        configAttribs[1] = 0;
+        if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+            std::cerr << "EGL: no OpenGL-capable config\n";
+            destroy();
+            return false;
+        }
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION_KHR, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        std::cerr << "EGL: failed to create OpenGL " << majorVersion << "." << minorVersion
+                  << " core context\n";
+        destroy();
+        return false;
+    }
+    m_context = ctx;
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!hasExtension(eglQueryString(dpy, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(dpy, config, pbufferAttribs);
+        if (surface == EGL_NO_SURFACE) {
+            std::cerr << "EGL: failed to create pbuffer surface\n";
+            destroy();
+            return false;
+        }
+        m_surface = surface;
+    }
+
+    if (!eglMakeCurrent(dpy, surface, surface, ctx)) {
+        std::cerr << "EGL: eglMakeCurrent failed\n";
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext::destroy()
+{
+    if (!m_display) return;
+
+    EGLDisplay dpy = (EGLDisplay)m_display;
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_surface) eglDestroySurface(dpy, (EGLSurface)m_surface);
+    if (m_context) eglDestroyContext(dpy, (EGLContext)m_context);
+    eglTerminate(dpy);
+
+    m_display = m_context = m_surface = nullptr;
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+
+#else // !OPENGLPRJ_HAVE_EGL
+
+bool HeadlessContext::create(int majorVersion, int minorVersion)
+{
+    (void)majorVersion;
+    (void)minorVersion;
+    std::cerr << "Headless mode needs EGL, which was not found at build time\n";
+    return false;
+}
+
+void HeadlessContext::destroy() {}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+    (void)name;
+    return nullptr;
+}
+
+#endif
+
+HeadlessContext::~HeadlessContext()
+{
+    destroy();
+}
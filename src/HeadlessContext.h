@@ -0,0 +1,26 @@
+#pragma once
+
+// Offscreen OpenGL context for rendering without a window or display server.
+// Uses EGL (surfaceless platform when available, pbuffer otherwise), so it runs
+// on Mesa llvmpipe on headless Linux boxes.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+
+    // Non-copyable (owns the EGL display/context)
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates a core profile context of the given version and makes it current.
+    bool create(int majorVersion, int minorVersion);
+    void destroy();
+
+    // Loader for gladLoadGLLoader
+    static void* getProcAddress(const char* name);
+
+private:
+    void* m_display = nullptr;
+    void* m_context = nullptr;
+    void* m_surface = nullptr;
+};
@@ -0,0 +1,508 @@
+#include "ImageWriter.h"
+#include "Parallel.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+
+// ---------------------------------------------------------------------------
+// Checksums
+// ---------------------------------------------------------------------------
+
+struct CrcTable {
+    uint32_t v[256];
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+            v[n] = c;
+        }
+    }
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char* p, size_t n)
+{
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = table.v[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static const uint32_t kAdlerBase = 65521;
+
+static uint32_t adler32(const unsigned char* p, size_t n)
+{
+    uint32_t a = 1, b = 0;
+    while (n > 0) {
+        // 5552 is the most bytes we can sum before b can overflow 32 bits
+        size_t block = n < 5552 ? n : 5552;
+        n -= block;
+        while (block--) {
+            a += *p++;
+            b += a;
+        }
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+    }
+    return (b << 16) | a;
+}
+
+// Adler-32 of A followed by B, from adler(A), adler(B) and len(B) (as in zlib)
+static uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    uint32_t rem = (uint32_t)(len2 % kAdlerBase);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % kAdlerBase);
+    sum1 += (adler2 & 0xFFFF) + kAdlerBase - 1;
+    sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + kAdlerBase - rem;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum2 >= (kAdlerBase << 1)) sum2 -= (kAdlerBase << 1);
+    if (sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return sum1 | (sum2 << 16);
+}
+
+static void putU32BE(std::vector<unsigned char>& out, uint32_t v)
+{
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+// ---------------------------------------------------------------------------
+// Deflate (fixed Huffman codes, greedy hash-chain LZ77)
+// ---------------------------------------------------------------------------
+
+static const int kLenBase[29]   = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const int kLenExtra[29]  = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const int kDistBase[30]  = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,
+                                    1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const int kDistExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+static const int kWindowSize = 32768;
+static const int kMinMatch   = 4;
+static const int kMaxMatch   = 258;
+static const int kHashBits   = 15;
+static const int kMaxChain   = 8;   // candidates checked per position: speed over ratio
+static const int kMaxInsert  = 32;  // longer matches don't index every position they cover
+
+static uint32_t reverseBits(uint32_t code, int len)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < len; i++) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+// Fixed Huffman codes from RFC 1951 3.2.6, stored bit-reversed because
+// deflate packs Huffman codes MSB first into an LSB-first bit stream.
+struct FixedCodes {
+    uint16_t litCode[288];
+    uint8_t  litLen[288];
+    uint16_t distCode[30];
+    uint8_t  lenSym[kMaxMatch + 1];
+    uint8_t  distSym[kWindowSize + 1];
+
+    FixedCodes() {
+        for (int s = 0; s < 288; s++) {
+            int code, len;
+            if (s < 144)      { code = 0x30 + s;          len = 8; }
+            else if (s < 256) { code = 0x190 + (s - 144); len = 9; }
+            else if (s < 280) { code = s - 256;           len = 7; }
+            else              { code = 0xC0 + (s - 280);  len = 8; }
+            litCode[s] = (uint16_t)reverseBits((uint32_t)code, len);
+            litLen[s] = (uint8_t)len;
+        }
+        for (int s = 0; s < 30; s++) distCode[s] = (uint16_t)reverseBits((uint32_t)s, 5);
+
+        for (int s = 0; s < 28; s++) {
+            for (int l = kLenBase[s]; l < kLenBase[s] + (1 << kLenExtra[s]) && l < kMaxMatch; l++)
+                lenSym[l] = (uint8_t)s;
+        }
+        lenSym[kMaxMatch] = 28; // 258 has its own code
+
+        for (int s = 0; s < 30; s++) {
+            for (int d = kDistBase[s]; d < kDistBase[s] + (1 << kDistExtra[s]) && d <= kWindowSize; d++)
+                distSym[d] = (uint8_t)s;
+        }
+    }
+};
+
+static const FixedCodes& fixedCodes()
+{
+    static const FixedCodes codes;
+    return codes;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : m_out(out) {}
+
+    void put(uint32_t bits, int count) {
+        m_acc |= (uint64_t)bits << m_count;
+        m_count += count;
+        while (m_count >= 8) {
+            m_out.push_back((unsigned char)(m_acc & 0xFF));
+            m_acc >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void alignToByte() {
+        if (m_count > 0) put(0, 8 - m_count);
+    }
+
+private:
+    std::vector<unsigned char>& m_out;
+    uint64_t m_acc = 0;
+    int m_count = 0;
+};
+
+static inline uint32_t hash4(const unsigned char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// Compresses one strip as a single non-final fixed-Huffman block followed by
+// a sync flush (empty stored block), so it ends byte aligned and the next
+// strip's block can simply be appended.
+static void deflateStrip(const unsigned char* data, size_t n, std::vector<unsigned char>& out)
+{
+    const FixedCodes& fc = fixedCodes();
+    BitWriter bw(out);
+
+    bw.put(0, 1); // BFINAL = 0
+    bw.put(1, 2); // BTYPE  = fixed Huffman
+
+    std::vector<int32_t> head((size_t)1 << kHashBits, -1);
+    std::vector<int32_t> prev(kWindowSize, -1);
+
+    auto insert = [&](size_t pos) {
+        uint32_t h = hash4(data + pos);
+        prev[pos & (kWindowSize - 1)] = head[h];
+        head[h] = (int32_t)pos;
+    };
+
+    size_t i = 0;
+    while (i + kMinMatch <= n) {
+        uint32_t h = hash4(data + i);
+        int32_t cand = head[h];
+        prev[i & (kWindowSize - 1)] = cand;
+        head[h] = (int32_t)i;
+
+        int bestLen = 0;
+        int bestDist = 0;
+        const int maxLen = (int)std::min<size_t>(kMaxMatch, n - i);
+        int chain = kMaxChain;
+
+        // stay strictly inside the window so prev[] entries are never stale
+        while (cand >= 0 && (int)(i - cand) < kWindowSize && chain-- > 0) {
+            const unsigned char* a = data + cand;
+            const unsigned char* b = data + i;
+            if (a[bestLen] == b[bestLen] && std::memcmp(a, b, kMinMatch) == 0) {
+                int len = kMinMatch;
+                while (len < maxLen && a[len] == b[len]) len++;
+                if (len > bestLen) {
+                    bestLen = len;
+                    bestDist = (int)(i - cand);
+                    if (len == maxLen) break;
+                }
+            }
+            int32_t next = prev[cand & (kWindowSize - 1)];
+            if (next >= cand) break;
+            cand = next;
+        }
+
+        if (bestLen >= kMinMatch) {
+            int ls = fc.lenSym[bestLen];
+            bw.put(fc.litCode[257 + ls], fc.litLen[257 + ls]);
+            bw.put((uint32_t)(bestLen - kLenBase[ls]), kLenExtra[ls]);
+
+            int ds = fc.distSym[bestDist];
+            bw.put(fc.distCode[ds], 5);
+            bw.put((uint32_t)(bestDist - kDistBase[ds]), kDistExtra[ds]);
+
+            if (bestLen <= kMaxInsert) {
+                for (size_t k = i + 1; k < i + bestLen && k + kMinMatch <= n; k++) insert(k);
+            }
+            i += bestLen;
+        } else {
+            bw.put(fc.litCode[data[i]], fc.litLen[data[i]]);
+            i++;
+        }
+    }
+    for (; i < n; i++) bw.put(fc.litCode[data[i]], fc.litLen[data[i]]);
+
+    bw.put(fc.litCode[256], fc.litLen[256]); // end of block
+
+    // sync flush: empty stored block, then byte aligned LEN/NLEN
+    bw.put(0, 1);
+    bw.put(0, 2);
+    bw.alignToByte();
+    out.push_back(0x00); out.push_back(0x00);
+    out.push_back(0xFF); out.push_back(0xFF);
+}
+
+// ---------------------------------------------------------------------------
+// PNG
+// ---------------------------------------------------------------------------
+
+static inline unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    if (pb <= pc) return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+static void applyFilter(int type, const unsigned char* cur, const unsigned char* prev,
+                        int rowBytes, int bpp, unsigned char* dst)
+{
+    int x = 0;
+    switch (type) {
+        case 0:
+            std::memcpy(dst, cur, rowBytes);
+            break;
+        case 1: // sub
+            for (; x < bpp; x++)      dst[x] = cur[x];
+            for (; x < rowBytes; x++) dst[x] = (unsigned char)(cur[x] - cur[x - bpp]);
+            break;
+        case 2: // up
+            for (; x < rowBytes; x++) dst[x] = (unsigned char)(cur[x] - prev[x]);
+            break;
+        case 3: // average
+            for (; x < bpp; x++)      dst[x] = (unsigned char)(cur[x] - (prev[x] >> 1));
+            for (; x < rowBytes; x++) dst[x] = (unsigned char)(cur[x] - ((cur[x - bpp] + prev[x]) >> 1));
+            break;
+        default: // paeth
+            for (; x < bpp; x++)      dst[x] = (unsigned char)(cur[x] - prev[x]);
+            for (; x < rowBytes; x++) dst[x] = (unsigned char)(cur[x] - paeth(cur[x - bpp], prev[x], prev[x - bpp]));
+            break;
+    }
+}
+
+// Writes filter byte + filtered row into out. Tries all five filters and keeps
+// the one with the smallest sum of absolute (signed) residuals, like libpng.
+// `prev` is a row of zeros for the first row of the image.
+static void filterRow(const unsigned char* cur, const unsigned char* prev, int rowBytes, int bpp,
+                      unsigned char* out, unsigned char* scratch)
+{
+    unsigned int bestScore = ~0u;
+    for (int type = 0; type < 5; type++) {
+        applyFilter(type, cur, prev, rowBytes, bpp, scratch);
+
+        unsigned int score = 0;
+        for (int x = 0; x < rowBytes; x++) score += (unsigned int)std::abs((int)(signed char)scratch[x]);
+
+        if (score < bestScore) {
+            bestScore = score;
+            out[0] = (unsigned char)type;
+            std::memcpy(out + 1, scratch, rowBytes);
+        }
+    }
+}
+
+static void appendChunk(std::vector<unsigned char>& out, const char* type,
+                        const unsigned char* data, size_t len)
+{
+    putU32BE(out, (uint32_t)len);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (len) out.insert(out.end(), data, data + len);
+    putU32BE(out, crc32(0, &out[start], len + 4));
+}
+
+bool encodePng(const ImageView& image, std::vector<unsigned char>& out, int threads)
+{
+    if (!image.pixels || image.width <= 0 || image.height <= 0 ||
+        (image.channels != 3 && image.channels != 4)) {
+        return false;
+    }
+
+    const int w = image.width;
+    const int h = image.height;
+    const int bpp = image.channels;
+    const int rowBytes = w * bpp;
+    const std::ptrdiff_t stride = image.stride ? image.stride : rowBytes;
+
+    if (threads <= 0) threads = defaultThreadCount();
+
+    // A few strips per thread for load balancing, but big enough that the
+    // per-strip window restart costs little compression.
+    const int minRows = std::max(8, (64 * 1024) / (rowBytes + 1));
+    int stripCount = std::min(h, threads * 4);
+    stripCount = std::max(1, std::min(stripCount, (h + minRows - 1) / minRows));
+    const int rowsPerStrip = (h + stripCount - 1) / stripCount;
+    stripCount = (h + rowsPerStrip - 1) / rowsPerStrip;
+
+    std::vector<std::vector<unsigned char> > chunks(stripCount);
+    std::vector<uint32_t> adlers(stripCount);
+    std::vector<size_t> rawSizes(stripCount);
+
+    parallelFor(stripCount, [&](int s) {
+        const int y0 = s * rowsPerStrip;
+        const int y1 = std::min(h, y0 + rowsPerStrip);
+
+        std::vector<unsigned char> filtered((size_t)(y1 - y0) * (rowBytes + 1));
+        std::vector<unsigned char> scratch(rowBytes);
+        std::vector<unsigned char> zeroRow(rowBytes, 0);
+        for (int y = y0; y < y1; y++) {
+            const unsigned char* cur = image.pixels + y * stride;
+            const unsigned char* prev = y > 0 ? cur - stride : zeroRow.data();
+            filterRow(cur, prev, rowBytes, bpp, &filtered[(size_t)(y - y0) * (rowBytes + 1)], scratch.data());
+        }
+        adlers[s] = adler32(filtered.data(), filtered.size());
+        rawSizes[s] = filtered.size();
+
+        // Build the whole IDAT chunk here so its CRC is computed in parallel too
+        std::vector<unsigned char> data;
+        data.reserve(filtered.size() / 2 + 64);
+        if (s == 0) {
+            data.push_back(0x78); // zlib header: deflate, 32K window,
+            data.push_back(0x01); // fastest level, no dictionary
+        }
+        deflateStrip(filtered.data(), filtered.size(), data);
+
+        appendChunk(chunks[s], "IDAT", data.data(), data.size());
+    }, threads);
+
+    uint32_t adler = adlers[0];
+    for (int s = 1; s < stripCount; s++) adler = adler32Combine(adler, adlers[s], rawSizes[s]);
+
+    out.clear();
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    out.insert(out.end(), kSignature, kSignature + 8);
+
+    std::vector<unsigned char> ihdr;
+    putU32BE(ihdr, (uint32_t)w);
+    putU32BE(ihdr, (uint32_t)h);
+    ihdr.push_back(8);                      // bit depth
+    ihdr.push_back(bpp == 4 ? 6 : 2);       // RGBA / RGB
+    ihdr.push_back(0);                      // deflate
+    ihdr.push_back(0);                      // adaptive filtering
+    ihdr.push_back(0);                      // no interlace
+    appendChunk(out, "IHDR", ihdr.data(), ihdr.size());
+
+    for (int s = 0; s < stripCount; s++) out.insert(out.end(), chunks[s].begin(), chunks[s].end());
+
+    // Close the zlib stream: empty final fixed block + Adler-32 of all strips
+    std::vector<unsigned char> tail;
+    tail.push_back(0x03);
+    tail.push_back(0x00);
+    putU32BE(tail, adler);
+    appendChunk(out, "IDAT", tail.data(), tail.size());
+
+    appendChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// QOI (https://qoiformat.org/qoi-specification.pdf)
+// ---------------------------------------------------------------------------
+
+bool encodeQoi(const ImageView& image, std::vector<unsigned char>& out)
+{
+    if (!image.pixels || image.width <= 0 || image.height <= 0 ||
+        (image.channels != 3 && image.channels != 4)) {
+        return false;
+    }
+
+    const int w = image.width;
+    const int h = image.height;
+    const int ch = image.channels;
+    const std::ptrdiff_t stride = image.stride ? image.stride : (std::ptrdiff_t)w * ch;
+
+    out.clear();
+    out.reserve((size_t)w * h * (ch + 1) + 22);
+    out.push_back('q'); out.push_back('o'); out.push_back('i'); out.push_back('f');
+    putU32BE(out, (uint32_t)w);
+    putU32BE(out, (uint32_t)h);
+    out.push_back((unsigned char)ch);
+    out.push_back(0); // sRGB with linear alpha
+
+    unsigned char index[64][4];
+    std::memset(index, 0, sizeof(index));
+    unsigned char prev[4] = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (int y = 0; y < h; y++) {
+        const unsigned char* row = image.pixels + y * stride;
+        for (int x = 0; x < w; x++) {
+            const unsigned char* p = row + x * ch;
+            unsigned char px[4] = { p[0], p[1], p[2], (unsigned char)(ch == 4 ? p[3] : 255) };
+            const bool last = (y == h - 1 && x == w - 1);
+
+            if (std::memcmp(px, prev, 4) == 0) {
+                run++;
+                if (run == 62 || last) {
+                    out.push_back((unsigned char)(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                out.push_back((unsigned char)(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            int idx = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+            if (std::memcmp(index[idx], px, 4) == 0) {
+                out.push_back((unsigned char)idx);
+            } else {
+                std::memcpy(index[idx], px, 4);
+
+                if (px[3] == prev[3]) {
+                    int vr = (signed char)(px[0] - prev[0]);
+                    int vg = (signed char)(px[1] - prev[1]);
+                    int vb = (signed char)(px[2] - prev[2]);
+                    int vgr = vr - vg;
+                    int vgb = vb - vg;
+
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        out.push_back((unsigned char)(0x40 | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2)));
+                    } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                        out.push_back((unsigned char)(0x80 | (vg + 32)));
+                        out.push_back((unsigned char)(((vgr + 8) << 4) | (vgb + 8)));
+                    } else {
+                        out.push_back(0xFE);
+                        out.push_back(px[0]); out.push_back(px[1]); out.push_back(px[2]);
+                    }
+                } else {
+                    out.push_back(0xFF);
+                    out.push_back(px[0]); out.push_back(px[1]); out.push_back(px[2]); out.push_back(px[3]);
+                }
+            }
+            std::memcpy(prev, px, 4);
+        }
+    }
+
+    for (int i = 0; i < 7; i++) out.push_back(0);
+    out.push_back(1);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+bool writeImage(const std::string& path, const ImageView& image, int threads)
+{
+    std::vector<unsigned char> bytes;
+    bool qoi = path.size() >= 4 && path.compare(path.size() - 4, 4, ".qoi") == 0;
+    bool ok = qoi ? encodeQoi(image, bytes) : encodePng(image, bytes, threads);
+    if (!ok) return false;
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file.is_open()) return false;
+    file.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+    return (bool)file;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Image encoders for captures.
+//
+// encodePng() splits the image into horizontal strips and filters and
+// deflates them on all cores. Every strip ends on a byte boundary (sync
+// flush), so the compressed strips are stitched into one valid zlib stream
+// and written as consecutive IDAT chunks. The Adler-32 of the stream is
+// combined from the per-strip checksums.
+//
+// encodeQoi() writes the "Quite OK Image" format: lossless, no entropy
+// coding, an order of magnitude faster than deflate. Use it for
+// intermediate frames that get post-processed anyway.
+
+struct ImageView {
+    const unsigned char* pixels = nullptr; // first (top) row
+    int width = 0;
+    int height = 0;
+    int channels = 3;                      // 3 = RGB, 4 = RGBA
+    std::ptrdiff_t stride = 0;             // bytes between rows, 0 = tightly packed
+};
+
+// threads = 0 uses every core
+bool encodePng(const ImageView& image, std::vector<unsigned char>& out, int threads = 0);
+bool encodeQoi(const ImageView& image, std::vector<unsigned char>& out);
+
+// Picks the encoder from the extension: ".qoi" writes QOI, anything else PNG
+bool writeImage(const std::string& path, const ImageView& image, int threads = 0);
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller passes 0
+inline int defaultThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+// Runs fn(0) .. fn(count - 1) on up to `threads` threads (0 = all cores).
+// Items are handed out dynamically, so uneven work still balances. Blocks
+// until every item is done; runs inline when there is nothing to split.
+inline void parallelFor(int count, const std::function<void(int)>& fn, int threads = 0)
+{
+    if (count <= 0) return;
+    if (threads <= 0) threads = defaultThreadCount();
+    if (threads > count) threads = count;
+
+    if (threads == 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (int t = 0; t < threads - 1; t++) pool.push_back(std::thread(worker));
+    worker(); // the calling thread takes a share too
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Grading and bloom parameters of the post chain (Renderer, and CpuGrade
+// for images on disk)
+struct PostSettings {
+    float brightness = 0.0f;
+    float contrast   = 1.0f;
+    float exposure   = 0.0f;
+    float saturation = 1.0f;
+    float vignette   = 0.0f;
+    float vignetteSoftness = 0.35f;
+    bool  bloomEnabled   = true;
+    float bloomThreshold = 0.3f;
+    float bloomStrength  = 1.8f;
+};
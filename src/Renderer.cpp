@@ -0,0 +1,873 @@
+#include "Renderer.h"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "ImageWriter.h"
+#include "Scene.h"
+#include "Trace.h"
+
+namespace {
+
+// Shader sources
+const char* const vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// per-instance (uInstanced): color (rgb) and material layer (a), then the
+// model matrix in locations 3..6
+layout (location = 2) in vec4 aInstColor;
+layout (location = 3) in mat4 aInstModel;
+
+// Shared per-frame constants (FrameUniforms in UniformBuffer.h)
+layout (std140) uniform Frame {
+    mat4 uView;
+    mat4 uProj;
+    vec4 uLightPos;
+    vec4 uLightColor;
+    vec4 uViewport; // width, height, 1/width, 1/height
+    vec4 uTime;
+    vec4 uBloom;    // x = bright pass threshold
+};
+
+uniform mat4 uModel;
+uniform vec3 uObjectColor;
+uniform int uMaterial; // layer of uMaterialTex, -1 = untextured
+uniform bool uInstanced;
+
+// GPU terrain (uTerrainGpu): aPos is (u, skirt 0/-1, v) on a unit patch placed
+// at uPatch (x0, z0, size); heights come from uHeightMap, which covers
+// uHeightMapXform (x0, z0, size) of the world
+uniform bool uTerrainGpu;
+uniform sampler2D uHeightMap;
+uniform vec3 uHeightMapXform;
+uniform vec3 uPatch;
+uniform float uSkirtDepth;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 vWorldPos;
+out vec3 vObjectColor;
+flat out int vMaterial;
+
+void main() {
+    mat4 model = uInstanced ? aInstModel : uModel;
+    vObjectColor = uInstanced ? aInstColor.rgb : uObjectColor;
+    vMaterial = uInstanced ? int(aInstColor.a + 0.5) : uMaterial;
+
+    if (uTerrainGpu) {
+        vec2 xz = uPatch.xy + aPos.xz * uPatch.z;
+        vec2 uv = (xz - uHeightMapXform.xy) / uHeightMapXform.z;
+        float h  = textureLod(uHeightMap, uv, 0.0).r;
+        float hL = textureLodOffset(uHeightMap, uv, 0.0, ivec2(-1, 0)).r;
+        float hR = textureLodOffset(uHeightMap, uv, 0.0, ivec2( 1, 0)).r;
+        float hD = textureLodOffset(uHeightMap, uv, 0.0, ivec2(0, -1)).r;
+        float hU = textureLodOffset(uHeightMap, uv, 0.0, ivec2(0,  1)).r;
+        float e  = uHeightMapXform.z / float(textureSize(uHeightMap, 0).x);
+
+        FragPos = vec3(xz.x, h + aPos.y * uSkirtDepth, xz.y);
+        Normal  = normalize(vec3(-(hR - hL), 2.0 * e, -(hU - hD)));
+    } else {
+        FragPos = vec3(model * vec4(aPos, 1.0));
+        Normal  = mat3(transpose(inverse(model))) * aNormal;
+    }
+    vWorldPos = FragPos;
+
+    gl_Position = uProj * uView * vec4(FragPos, 1.0);
+})";
+
+const char* const fragmentShaderSource = R"(
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+// Bloom source: the color where it is brighter than the threshold
+layout (location = 1) out vec4 BrightColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec3 vWorldPos;
+in vec3 vObjectColor;
+flat in int vMaterial;
+
+// Shared per-frame constants (FrameUniforms in UniformBuffer.h)
+layout (std140) uniform Frame {
+    mat4 uView;
+    mat4 uProj;
+    vec4 uLightPos;
+    vec4 uLightColor;
+    vec4 uViewport; // width, height, 1/width, 1/height
+    vec4 uTime;
+    vec4 uBloom;    // x = bright pass threshold
+};
+
+// Materials: one texture array layer each, plus a tint and a triplanar scale
+// (MaterialUniforms in UniformBuffer.h)
+const int kMaxMaterials = 8;
+uniform sampler2DArray uMaterialTex;
+layout (std140) uniform Materials {
+    vec4 uMaterialTint[kMaxMaterials];
+    vec4 uMaterialScale[kMaxMaterials];
+};
+
+vec3 TriplanarTex(sampler2DArray tex, float layer, vec3 worldPos, vec3 worldNormal, vec2 scale)
+{
+    vec3 n = normalize(worldNormal);
+    vec3 w = abs(n);
+    // sharpen blend a bit so it doesn't look muddy
+    w = pow(w, vec3(4.0));
+    w /= (w.x + w.y + w.z);
+
+    vec2 uvX = worldPos.zy * scale; // projection onto YZ (for X-facing)
+    vec2 uvY = worldPos.xz * scale; // projection onto XZ (for Y-facing)
+    vec2 uvZ = worldPos.xy * scale; // projection onto XY (for Z-facing)
+
+    vec3 x = texture(tex, vec3(uvX, layer)).rgb;
+    vec3 y = texture(tex, vec3(uvY, layer)).rgb;
+    vec3 z = texture(tex, vec3(uvZ, layer)).rgb;
+
+    return x * w.x + y * w.y + z * w.z;
+}
+
+void main() {
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(uLightPos.xyz - FragPos);
+
+    float diff = max(dot(norm, lightDir), 0.0);
+
+    vec3 ambient = 0.15 * uLightColor.rgb;
+    vec3 diffuse = diff * uLightColor.rgb;
+
+    vec3 baseColor = vObjectColor;
+
+    if (vMaterial >= 0) {
+        vec3 texColor = TriplanarTex(uMaterialTex, float(vMaterial), vWorldPos, Normal, uMaterialScale[vMaterial].xy);
+        baseColor = texColor * uMaterialTint[vMaterial].rgb * vObjectColor;
+    }
+
+
+    vec3 result = (ambient + diffuse) * baseColor;
+    FragColor = vec4(result, 1.0);
+
+    float luma = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = vec4(luma > uBloom.x ? result : vec3(0.0), 1.0);
+})";
+
+const char* const ppVertexShaderSrc = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aUV;
+
+out vec2 vUV;
+
+void main() {
+    vUV = aUV;
+    gl_Position = vec4(aPos, 0.0, 1.0);
+}
+)";
+
+// Grading, shared by the post fragment shader and the compute kernel (each
+// puts its own #version line in front). CpuGrade.cpp mirrors it step by step
+// for images on disk: keep the two in sync.
+const char* const gradingSrc = R"(
+uniform float uBrightness;
+uniform float uContrast;
+uniform float uExposure;
+uniform float uSaturation;
+uniform float uVignette;
+uniform float uVignetteSoftness;
+uniform float uBloomStrength;
+uniform bool  uBloomEnabled;
+
+vec3 Grade(vec3 color, vec3 bloom, vec2 uv) {
+    // --- exposure (photographic) ---
+    // exposure in "stops": +1 doubles brightness, -1 halves
+    color *= exp2(uExposure);
+
+    // --- brightness ---
+    color += vec3(uBrightness);
+
+    // --- contrast (pivot around 0.5) ---
+    color = (color - 0.5) * uContrast + 0.5;
+
+    // --- saturation ---
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    vec3 gray = vec3(luma);
+    color = mix(gray, color, uSaturation);
+
+    // --- vignette ---
+    vec2 center = vec2(0.5, 0.5);
+    float dist = distance(uv, center); // 0 at center, ~0.707 at corner
+    // smooth darkening curve
+    float vig = smoothstep(0.707 - uVignetteSoftness, 0.707, dist);
+    color *= (1.0 - uVignette * vig);
+
+    if (uBloomEnabled) {
+        color += bloom * uBloomStrength;
+    }
+    return color;
+}
+)";
+
+const char* const ppFragmentShaderSrc = R"(
+out vec4 FragColor;
+in vec2 vUV;
+
+uniform sampler2D uScene;
+uniform sampler2D uBloom;
+
+void main() {
+    vec3 bloom = uBloomEnabled ? texture(uBloom, vUV).rgb : vec3(0.0);
+    FragColor = vec4(Grade(texture(uScene, vUV).rgb, bloom, vUV), 1.0);
+}
+)";
+
+// Bloom downsample: 13 taps as five overlapping 2x2 boxes (Jimenez 2014),
+// wide enough that small bright spots don't flicker as the camera moves
+const char* const downsampleFragSrc = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 vUV;
+
+uniform sampler2D uImage;
+uniform vec2 uTexelSize; // of uImage
+
+void main() {
+    vec2 t = uTexelSize;
+    vec3 a = texture(uImage, vUV + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(uImage, vUV + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(uImage, vUV + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(uImage, vUV + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(uImage, vUV).rgb;
+    vec3 f = texture(uImage, vUV + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(uImage, vUV + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(uImage, vUV + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(uImage, vUV + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(uImage, vUV + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(uImage, vUV + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(uImage, vUV + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(uImage, vUV + t * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(result, 1.0);
+}
+)";
+
+// Bloom upsample: 3x3 tent, added onto the next larger level by blending
+const char* const upsampleFragSrc = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 vUV;
+
+uniform sampler2D uImage;
+uniform vec2 uTexelSize; // of uImage
+
+void main() {
+    vec2 t = uTexelSize;
+    vec3 result = texture(uImage, vUV).rgb * 4.0;
+    result += (texture(uImage, vUV + vec2(-t.x, 0.0)).rgb +
+               texture(uImage, vUV + vec2( t.x, 0.0)).rgb +
+               texture(uImage, vUV + vec2(0.0, -t.y)).rgb +
+               texture(uImage, vUV + vec2(0.0,  t.y)).rgb) * 2.0;
+    result += texture(uImage, vUV + vec2(-t.x, -t.y)).rgb +
+              texture(uImage, vUV + vec2( t.x, -t.y)).rgb +
+              texture(uImage, vUV + vec2(-t.x,  t.y)).rgb +
+              texture(uImage, vUV + vec2( t.x,  t.y)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
+)";
+
+// Compute post path (GL 4.3). TILE, RADIUS and SIGMA come from
+// ComputePostSettings.
+//
+// Separable Gaussian, one pass per direction. A workgroup blurs TILE texels of
+// one row (or column): it reads them and RADIUS texels on each side into
+// shared memory once, instead of every thread fetching 2 * RADIUS + 1 taps.
+// The horizontal pass samples the full resolution bright target at the half
+// resolution texel centers, so the downsample comes for free.
+const char* const blurComputeSrc = R"(
+layout (local_size_x = TILE) in;
+
+layout (binding = 0) uniform sampler2D uSource;
+layout (rgba16f, binding = 0) writeonly uniform image2D uDest;
+uniform bool uHorizontal;
+
+shared vec3 sTexels[TILE + 2 * RADIUS];
+shared float sWeights[RADIUS + 1];
+
+void main() {
+    ivec2 size = imageSize(uDest);
+    int lineLength = uHorizontal ? size.x : size.y;
+    int line = int(gl_WorkGroupID.y);
+    int start = int(gl_WorkGroupID.x) * TILE;
+    int t = int(gl_LocalInvocationID.x);
+
+    for (int i = t; i < TILE + 2 * RADIUS; i += TILE) {
+        int along = clamp(start + i - RADIUS, 0, lineLength - 1);
+        ivec2 p = uHorizontal ? ivec2(along, line) : ivec2(line, along);
+        sTexels[i] = textureLod(uSource, (vec2(p) + 0.5) / vec2(size), 0.0).rgb;
+    }
+    if (t <= RADIUS) sWeights[t] = exp(-float(t * t) / (2.0 * SIGMA * SIGMA));
+    barrier();
+
+    if (start + t >= lineLength) return;
+    float norm = sWeights[0];
+    vec3 sum = sTexels[t + RADIUS] * sWeights[0];
+    for (int i = 1; i <= RADIUS; i++) {
+        sum += (sTexels[t + RADIUS - i] + sTexels[t + RADIUS + i]) * sWeights[i];
+        norm += 2.0 * sWeights[i];
+    }
+    ivec2 p = uHorizontal ? ivec2(start + t, line) : ivec2(line, start + t);
+    imageStore(uDest, p, vec4(sum / norm, 1.0));
+}
+)";
+
+// Grading and bloom composite in one kernel, straight into the RGBA8 output;
+// GROUP x GROUP pixels per workgroup
+const char* const gradeComputeSrc = R"(
+layout (local_size_x = GROUP, local_size_y = GROUP) in;
+
+layout (binding = 0) uniform sampler2D uScene;
+layout (binding = 1) uniform sampler2D uBloom;
+layout (rgba8, binding = 0) writeonly uniform image2D uOutput;
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(uOutput);
+    if (p.x >= size.x || p.y >= size.y) return;
+
+    vec2 uv = (vec2(p) + 0.5) / vec2(size);
+    vec3 bloom = uBloomEnabled ? textureLod(uBloom, uv, 0.0).rgb : vec3(0.0);
+    imageStore(uOutput, p, vec4(Grade(texelFetch(uScene, p, 0).rgb, bloom, uv), 1.0));
+}
+)";
+
+int groupCount(int size, int groupSize)
+{
+    return (size + groupSize - 1) / groupSize;
+}
+
+// Far enough for kilometre-scale terrain vistas
+const float kFarPlane = 2000.0f;
+
+// Sky (clear) color of the scene pass
+const glm::vec3 kSkyColor(0.55f, 0.75f, 0.95f);
+
+float luminance(const glm::vec3& c)
+{
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+void allocColorTexture(unsigned int tex, int width, int height, GLenum internalFormat = GL_RGB16F)
+{
+    GLState::bindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+} // namespace
+
+bool Renderer::init(int width, int height, bool offscreenOutput, const std::string& shaderCacheDir)
+{
+    destroy();
+
+    // Compile shaders: all at once, through the program binary cache
+    const std::string postFragmentSrc = std::string("#version 330 core\n") + gradingSrc + ppFragmentShaderSrc;
+    const ShaderSource sources[] = {
+        { vertexShaderSource, fragmentShaderSource },
+        { ppVertexShaderSrc, postFragmentSrc.c_str() },
+        { ppVertexShaderSrc, downsampleFragSrc },
+        { ppVertexShaderSrc, upsampleFragSrc },
+    };
+    Shader* const programs[] = { &m_lightingShader, &m_postShader, &m_downsampleShader, &m_upsampleShader };
+    const int programCount = (int)(sizeof(programs) / sizeof(programs[0]));
+    ShaderCache shaderCache;
+    shaderCache.init(shaderCacheDir);
+    bool complete = shaderCache.build(sources, programs, programCount);
+    m_shaderStats = shaderCache.stats();
+
+    m_lightingShader.use();
+    m_lightingShader.setInt("uMaterialTex", 0);
+    m_lightingShader.setInt("uHeightMap", 1);
+
+    m_postShader.use();
+    m_postShader.setInt("uScene", 0); // texture units once
+    m_postShader.setInt("uBloom", 1);
+
+    m_downsampleShader.use();
+    m_downsampleShader.setInt("uImage", 0);
+
+    m_upsampleShader.use();
+    m_upsampleShader.setInt("uImage", 0);
+
+    m_post.grade = gradeUniforms(m_postShader);
+    m_post.downsampleTexel = m_downsampleShader.uniform<glm::vec2>("uTexelSize");
+    m_post.upsampleTexel = m_upsampleShader.uniform<glm::vec2>("uTexelSize");
+
+    // Uniform blocks, both read by the lighting program only: the Frame
+    // buffer is filled here, the Materials one by the scene
+    m_lightingShader.bindUniformBlock("Frame", FrameBinding);
+    m_lightingShader.bindUniformBlock("Materials", MaterialBinding);
+    m_frameUniforms.init(FrameBinding, sizeof(FrameUniforms));
+
+    // scene target: HDR color + depth/stencil
+    glGenFramebuffers(1, &m_sceneFBO);
+    glGenTextures(1, &m_sceneColorTex);
+    glGenTextures(1, &m_sceneBrightTex);
+    glGenRenderbuffers(1, &m_sceneRBO);
+
+    // bloom pyramid
+    glGenFramebuffers(kMaxBloomLevels, m_bloomFBO);
+    glGenTextures(kMaxBloomLevels, m_bloomTex);
+
+    if (offscreenOutput) {
+        glGenFramebuffers(1, &m_outputFBO);
+        glGenTextures(1, &m_outputTex);
+        GLState::bindTexture(GL_TEXTURE_2D, m_outputTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // allocate storage and attach
+    resize(width, height);
+
+    struct Target { unsigned int fbo; unsigned int tex; const char* name; };
+    std::vector<Target> targets;
+    const Target scene = { m_sceneFBO, m_sceneColorTex, "Scene" };
+    targets.push_back(scene);
+    for (int i = 0; i < kMaxBloomLevels; i++) {
+        const Target level = { m_bloomFBO[i], m_bloomTex[i], "Bloom" };
+        targets.push_back(level);
+    }
+    const Target output = { m_outputFBO, m_outputTex, "Output" };
+    targets.push_back(output);
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (targets[i].fbo == 0) continue;
+        glBindFramebuffer(GL_FRAMEBUFFER, targets[i].fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[i].tex, 0);
+        const GLenum db[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        if (targets[i].fbo == m_sceneFBO) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_sceneBrightTex, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_sceneRBO);
+            glDrawBuffers(2, db);
+        } else {
+            glDrawBuffers(1, db);
+        }
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR: " << targets[i].name << " FBO incomplete!\n";
+            complete = false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    float quadVertices[] = {
+        // positions   // uvs
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f,
+
+         1.0f,  1.0f,  1.0f, 1.0f,
+        -1.0f,  1.0f,  0.0f, 1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f
+    };
+
+    glGenVertexArrays(1, &m_quadVAO);
+    glGenBuffers(1, &m_quadVBO);
+
+    GLState::bindVertexArray(m_quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    return complete;
+}
+
+void Renderer::destroy()
+{
+    // Shaders first: the GL context may be gone by the time globals are destructed
+    m_lightingShader = Shader();
+    m_postShader = Shader();
+    m_downsampleShader = Shader();
+    m_upsampleShader = Shader();
+    m_uniformScene = nullptr;
+    disableComputePost();
+    m_frameUniforms.destroy();
+
+    if (m_quadVBO) glDeleteBuffers(1, &m_quadVBO);
+    if (m_quadVAO) GLState::deleteVertexArrays(1, &m_quadVAO);
+    m_quadVBO = m_quadVAO = 0;
+
+    if (m_sceneFBO) {
+        glDeleteFramebuffers(1, &m_sceneFBO);
+        GLState::deleteTextures(1, &m_sceneColorTex);
+        GLState::deleteTextures(1, &m_sceneBrightTex);
+        glDeleteRenderbuffers(1, &m_sceneRBO);
+        glDeleteFramebuffers(kMaxBloomLevels, m_bloomFBO);
+        GLState::deleteTextures(kMaxBloomLevels, m_bloomTex);
+    }
+    if (m_outputFBO) {
+        glDeleteFramebuffers(1, &m_outputFBO);
+        GLState::deleteTextures(1, &m_outputTex);
+    }
+    m_sceneFBO = m_sceneColorTex = m_sceneBrightTex = m_sceneRBO = 0;
+    for (int i = 0; i < kMaxBloomLevels; i++) m_bloomFBO[i] = m_bloomTex[i] = 0;
+    m_bloomLevels = 0;
+    m_outputFBO = m_outputTex = 0;
+}
+
+void Renderer::resize(int width, int height)
+{
+    // Avoid zero-sized resize (can happen when minimizing)
+    if (width <= 0 || height <= 0 || m_sceneFBO == 0) return;
+    m_width = width;
+    m_height = height;
+
+    allocColorTexture(m_sceneColorTex, width, height);
+    // only feeds the bloom pyramid: a packed float format is plenty
+    allocColorTexture(m_sceneBrightTex, width, height, GL_R11F_G11F_B10F);
+
+    // Half resolution down to about 8 pixels; every level gets storage so
+    // the FBOs stay complete, only the first m_bloomLevels are drawn
+    m_bloomLevels = 0;
+    for (int i = 0; i < kMaxBloomLevels; i++) {
+        m_bloomWidth[i] = std::max(1, width >> (i + 1));
+        m_bloomHeight[i] = std::max(1, height >> (i + 1));
+        allocColorTexture(m_bloomTex[i], m_bloomWidth[i], m_bloomHeight[i]);
+        if (i == 0 || std::min(m_bloomWidth[i], m_bloomHeight[i]) >= 8) m_bloomLevels = i + 1;
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, m_sceneRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    if (m_computePost) allocComputeTargets();
+
+    if (m_outputTex != 0) {
+        GLState::bindTexture(GL_TEXTURE_2D, m_outputTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+void Renderer::drawQuad()
+{
+    GLState::bindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void Renderer::renderFrame(Scene& scene, const Camera& camera, const glm::vec3& lightPos, float time,
+                           const PostSettings& post, GpuProfiler* profiler)
+{
+    TRACE_SCOPE("Renderer::renderFrame");
+    glViewport(0, 0, m_width, m_height);
+
+    if (profiler) profiler->begin("scene");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFBO);
+    glEnable(GL_DEPTH_TEST);
+    // The bright target is only written while bloom is on; the sky gets the
+    // same threshold as the geometry
+    const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(post.bloomEnabled ? 2 : 1, drawBuffers);
+    const float sky[4] = { kSkyColor.x, kSkyColor.y, kSkyColor.z, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, sky);
+    if (post.bloomEnabled) {
+        const glm::vec3 skyBright = luminance(kSkyColor) > post.bloomThreshold ? kSkyColor : glm::vec3(0.0f);
+        const float bright[4] = { skyBright.x, skyBright.y, skyBright.z, 1.0f };
+        glClearBufferfv(GL_COLOR, 1, bright);
+    }
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // ----- FRAME CONSTANTS (one upload, shared by every program) -----
+    FrameUniforms frame;
+    frame.view = camera.getViewMatrix();
+    frame.proj = glm::perspective(glm::radians(camera.fov()), (float)m_width / (float)m_height, 0.1f, kFarPlane);
+    frame.lightPos = glm::vec4(lightPos, 1.0f);
+    frame.lightColor = glm::vec4(1.0f);
+    frame.viewport = glm::vec4((float)m_width, (float)m_height, 1.0f / m_width, 1.0f / m_height);
+    frame.time = glm::vec4(time, 0.0f, 0.0f, 0.0f);
+    frame.bloom = glm::vec4(post.bloomThreshold, 0.0f, 0.0f, 0.0f);
+    m_frameUniforms.update(&frame, sizeof(frame));
+
+    if (&scene != m_uniformScene) {
+        scene.resolveUniforms(m_lightingShader);
+        m_uniformScene = &scene;
+    }
+    scene.render(m_lightingShader, frame.view, frame.proj);
+    if (profiler) profiler->end();
+
+    renderPost(post, profiler);
+}
+
+bool Renderer::renderImage(const ImageView& image, const PostSettings& post)
+{
+    TRACE_SCOPE("Renderer::renderImage");
+    if (image.width != m_width || image.height != m_height || image.channels < 3) return false;
+
+    // The scene color and the bright target, tightly packed RGB
+    const std::ptrdiff_t stride = image.stride ? image.stride : (std::ptrdiff_t)image.width * image.channels;
+    std::vector<unsigned char> color((size_t)m_width * m_height * 3);
+    std::vector<unsigned char> bright(color.size(), 0);
+    for (int y = 0; y < m_height; y++) {
+        const unsigned char* src = image.pixels + y * stride;
+        unsigned char* c = &color[(size_t)y * m_width * 3];
+        unsigned char* b = &bright[(size_t)y * m_width * 3];
+        for (int x = 0; x < m_width; x++, src += image.channels, c += 3, b += 3) {
+            c[0] = src[0];
+            c[1] = src[1];
+            c[2] = src[2];
+            if (post.bloomEnabled && luminance(glm::vec3(c[0], c[1], c[2]) / 255.0f) > post.bloomThreshold) {
+                b[0] = c[0];
+                b[1] = c[1];
+                b[2] = c[2];
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GLState::bindTexture(GL_TEXTURE_2D, m_sceneColorTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, color.data());
+    GLState::bindTexture(GL_TEXTURE_2D, m_sceneBrightTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, bright.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    renderPost(post, nullptr);
+    return true;
+}
+
+void Renderer::renderPost(const PostSettings& post, GpuProfiler* profiler)
+{
+    if (m_computePost) {
+        renderPostCompute(post, profiler);
+        return;
+    }
+
+    if (post.bloomEnabled) {
+        renderBloom(profiler);
+    }
+
+    if (profiler) profiler->begin("post");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+    glViewport(0, 0, m_width, m_height);
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0,0,0,1);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    m_postShader.use();
+
+    // grading; bloom level 0 holds the sum of every level
+    setGrade(m_postShader, m_post.grade, post, post.bloomStrength / (float)m_bloomLevels);
+
+    // textures
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, m_sceneColorTex);
+
+    GLState::activeTexture(GL_TEXTURE1);
+    GLState::bindTexture(GL_TEXTURE_2D, m_bloomTex[0]);
+    drawQuad();
+    if (profiler) profiler->end();
+}
+
+void Renderer::renderBloom(GpuProfiler* profiler)
+{
+    TRACE_SCOPE("Renderer::renderBloom");
+    glDisable(GL_DEPTH_TEST);
+    if (profiler) profiler->begin("bloom");
+
+    // Down the pyramid: each level filters the one above it, level 0 the
+    // scene pass's bright target
+    m_downsampleShader.use();
+    GLState::activeTexture(GL_TEXTURE0);
+    for (int i = 0; i < m_bloomLevels; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFBO[i]);
+        glViewport(0, 0, m_bloomWidth[i], m_bloomHeight[i]);
+        const glm::vec2 srcSize = i == 0 ? glm::vec2((float)m_width, (float)m_height)
+                                         : glm::vec2((float)m_bloomWidth[i - 1], (float)m_bloomHeight[i - 1]);
+        m_downsampleShader.set(m_post.downsampleTexel, glm::vec2(1.0f / srcSize.x, 1.0f / srcSize.y));
+        GLState::bindTexture(GL_TEXTURE_2D, i == 0 ? m_sceneBrightTex : m_bloomTex[i - 1]);
+        drawQuad();
+    }
+
+    // And back up, each level added onto the next larger one, so level 0
+    // ends up with the glow of every scale
+    m_upsampleShader.use();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int i = m_bloomLevels - 1; i > 0; i--) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFBO[i - 1]);
+        glViewport(0, 0, m_bloomWidth[i - 1], m_bloomHeight[i - 1]);
+        m_upsampleShader.set(m_post.upsampleTexel, glm::vec2(1.0f / m_bloomWidth[i], 1.0f / m_bloomHeight[i]));
+        GLState::bindTexture(GL_TEXTURE_2D, m_bloomTex[i]);
+        drawQuad();
+    }
+    glDisable(GL_BLEND);
+    if (profiler) profiler->end();
+}
+
+Renderer::GradeUniforms Renderer::gradeUniforms(Shader& shader)
+{
+    GradeUniforms u;
+    u.brightness = shader.uniform<float>("uBrightness");
+    u.contrast = shader.uniform<float>("uContrast");
+    u.exposure = shader.uniform<float>("uExposure");
+    u.saturation = shader.uniform<float>("uSaturation");
+    u.vignette = shader.uniform<float>("uVignette");
+    u.vignetteSoftness = shader.uniform<float>("uVignetteSoftness");
+    u.bloomStrength = shader.uniform<float>("uBloomStrength");
+    u.bloomEnabled = shader.uniform<int>("uBloomEnabled");
+    return u;
+}
+
+void Renderer::setGrade(Shader& shader, const GradeUniforms& u, const PostSettings& post, float bloomStrength)
+{
+    shader.set(u.brightness, post.brightness);
+    shader.set(u.contrast, post.contrast);
+    shader.set(u.exposure, post.exposure);
+    shader.set(u.saturation, post.saturation);
+    shader.set(u.vignette, post.vignette);
+    shader.set(u.vignetteSoftness, post.vignetteSoftness);
+    shader.set(u.bloomStrength, bloomStrength);
+    shader.set(u.bloomEnabled, post.bloomEnabled ? 1 : 0);
+}
+
+bool Renderer::enableComputePost(const ComputePostSettings& settings)
+{
+    disableComputePost();
+#ifdef GL_VERSION_4_3
+    if (!GLAD_GL_VERSION_4_3 || m_sceneFBO == 0) return false;
+
+    m_computeSettings = settings;
+    m_computeSettings.blurTile = std::max(32, settings.blurTile);
+    // every weight is written by one thread of the tile
+    m_computeSettings.blurRadius = std::max(1, std::min(settings.blurRadius, m_computeSettings.blurTile - 1));
+    m_computeSettings.groupSize = std::max(1, settings.groupSize);
+
+    std::ostringstream blurSrc;
+    blurSrc << "#version 430 core\n"
+            << "#define TILE " << m_computeSettings.blurTile << "\n"
+            << "#define RADIUS " << m_computeSettings.blurRadius << "\n"
+            << "#define SIGMA " << std::max(1.0f, m_computeSettings.blurRadius / 3.0f) << "\n"
+            << blurComputeSrc;
+    std::ostringstream gradeSrc;
+    gradeSrc << "#version 430 core\n"
+             << "#define GROUP " << m_computeSettings.groupSize << "\n"
+             << gradingSrc << gradeComputeSrc;
+
+    m_blurCompute = Shader::compute(blurSrc.str().c_str());
+    m_gradeCompute = Shader::compute(gradeSrc.str().c_str());
+    if (m_blurCompute.id() == 0 || m_gradeCompute.id() == 0) {
+        m_blurCompute = Shader();
+        m_gradeCompute = Shader();
+        return false;
+    }
+    m_computeHorizontal = m_blurCompute.uniform<int>("uHorizontal");
+    m_computeGrade = gradeUniforms(m_gradeCompute);
+
+    glGenTextures(2, m_computeBloomTex);
+    if (m_outputFBO == 0) {
+        // the default framebuffer can't be an image: grade into a texture, then blit
+        glGenTextures(1, &m_computeOutTex);
+        glGenFramebuffers(1, &m_computeOutFBO);
+    }
+    m_computePost = true;
+    allocComputeTargets();
+    if (m_computeOutFBO) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_computeOutFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_computeOutTex, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    return true;
+#else
+    (void)settings;
+    return false;
+#endif
+}
+
+void Renderer::disableComputePost()
+{
+    m_blurCompute = Shader();
+    m_gradeCompute = Shader();
+    if (m_computeBloomTex[0]) GLState::deleteTextures(2, m_computeBloomTex);
+    if (m_computeOutTex) GLState::deleteTextures(1, &m_computeOutTex);
+    if (m_computeOutFBO) glDeleteFramebuffers(1, &m_computeOutFBO);
+    m_computeBloomTex[0] = m_computeBloomTex[1] = 0;
+    m_computeOutTex = m_computeOutFBO = 0;
+    m_computePost = false;
+}
+
+void Renderer::allocComputeTargets()
+{
+    // image2D stores need 4-channel formats
+    allocColorTexture(m_computeBloomTex[0], m_bloomWidth[0], m_bloomHeight[0], GL_RGBA16F);
+    allocColorTexture(m_computeBloomTex[1], m_bloomWidth[0], m_bloomHeight[0], GL_RGBA16F);
+    if (m_computeOutTex) allocColorTexture(m_computeOutTex, m_width, m_height, GL_RGBA8);
+}
+
+void Renderer::renderPostCompute(const PostSettings& post, GpuProfiler* profiler)
+{
+    TRACE_SCOPE("Renderer::renderPostCompute");
+#ifdef GL_VERSION_4_3
+    const int tile = m_computeSettings.blurTile;
+    const int bloomWidth = m_bloomWidth[0], bloomHeight = m_bloomHeight[0];
+
+    if (post.bloomEnabled) {
+        if (profiler) profiler->begin("bloom");
+        m_blurCompute.use();
+        GLState::activeTexture(GL_TEXTURE0);
+
+        // rows: full resolution bright target -> half resolution
+        m_blurCompute.set(m_computeHorizontal, 1);
+        GLState::bindTexture(GL_TEXTURE_2D, m_sceneBrightTex);
+        glBindImageTexture(0, m_computeBloomTex[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(groupCount(bloomWidth, tile), bloomHeight, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        // columns
+        m_blurCompute.set(m_computeHorizontal, 0);
+        GLState::bindTexture(GL_TEXTURE_2D, m_computeBloomTex[0]);
+        glBindImageTexture(0, m_computeBloomTex[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(groupCount(bloomHeight, tile), bloomWidth, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        if (profiler) profiler->end();
+    }
+
+    if (profiler) profiler->begin("post");
+    m_gradeCompute.use();
+    setGrade(m_gradeCompute, m_computeGrade, post, post.bloomStrength);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, m_sceneColorTex);
+    GLState::activeTexture(GL_TEXTURE1);
+    GLState::bindTexture(GL_TEXTURE_2D, m_computeBloomTex[1]);
+
+    const unsigned int target = m_outputTex ? m_outputTex : m_computeOutTex;
+    glBindImageTexture(0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    const int group = m_computeSettings.groupSize;
+    glDispatchCompute(groupCount(m_width, group), groupCount(m_height, group), 1);
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+
+    if (m_computeOutFBO) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_computeOutFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_outputFBO);
+        glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+    if (profiler) profiler->end();
+#else
+    (void)post;
+    (void)profiler;
+#endif
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include "PostSettings.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "UniformBuffer.h"
+
+class Scene;
+class Camera;
+class GpuProfiler;
+struct ImageView;
+
+// Optional GL 4.3 post path (Renderer::enableComputePost). Sizes are baked
+// into the kernels, so changing them means enabling again.
+struct ComputePostSettings {
+    int blurTile   = 128; // texels per blur workgroup (one row or column span)
+    int blurRadius = 16;  // Gaussian taps each side, at half resolution
+    int groupSize  = 16;  // grading workgroup is groupSize x groupSize
+};
+
+// The frame pipeline shared by the app and the benchmarks:
+// scene (HDR color + thresholded bright target) -> bloom pyramid down and up
+// -> grading/bloom composite. With the compute path enabled the pyramid is
+// replaced by a tiled separable Gaussian, and grading runs as one kernel.
+class Renderer {
+public:
+    Renderer() = default;
+
+    // Non-copyable (owns GL objects)
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // offscreenOutput: composite into an RGBA8 target instead of the default
+    // framebuffer (headless contexts don't have one). shaderCacheDir: where
+    // linked programs are cached (empty = compile every time).
+    bool init(int width, int height, bool offscreenOutput, const std::string& shaderCacheDir = std::string());
+    void destroy();
+    void resize(int width, int height);
+
+    // Renders one frame; the result ends up bound in outputFBO(). `time` is
+    // the caller's scene clock in seconds (uTime), so fixed-step runs stay
+    // deterministic. Passes are timed with `profiler` when given.
+    void renderFrame(Scene& scene, const Camera& camera, const glm::vec3& lightPos, float time,
+                     const PostSettings& post, GpuProfiler* profiler);
+
+    // Runs only the post chain on an 8-bit RGB(A) image of the render size,
+    // as if the scene pass had drawn it (the bright target gets the same
+    // threshold). Rows go in as given, so glReadPixels on outputFBO() returns
+    // them in the same order. Used to check CpuGrade against Grade().
+    bool renderImage(const ImageView& image, const PostSettings& post);
+
+    // Switches bloom and grading to compute kernels. False (and the fragment
+    // path stays) without GL 4.3 or if the kernels fail to build.
+    bool enableComputePost(const ComputePostSettings& settings);
+    void disableComputePost();
+    bool computePost() const { return m_computePost; }
+    const ComputePostSettings& computePostSettings() const { return m_computeSettings; }
+
+    unsigned int outputFBO() const { return m_outputFBO; }
+    // How the last init() got its programs
+    const ShaderCache::Stats& shaderStats() const { return m_shaderStats; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+private:
+    void drawQuad();
+    void renderPost(const PostSettings& post, GpuProfiler* profiler);
+    void renderBloom(GpuProfiler* profiler);
+    void renderPostCompute(const PostSettings& post, GpuProfiler* profiler);
+    void allocComputeTargets();
+
+    int m_width = 0;
+    int m_height = 0;
+
+    Shader m_lightingShader;
+    Shader m_postShader;
+    Shader m_downsampleShader;
+    Shader m_upsampleShader;
+    ShaderCache::Stats m_shaderStats;
+
+    // Uniforms of the shared Grade() function, in any program including it
+    struct GradeUniforms {
+        Uniform<float> brightness, contrast, exposure, saturation;
+        Uniform<float> vignette, vignetteSoftness, bloomStrength;
+        Uniform<int> bloomEnabled;
+    };
+    static GradeUniforms gradeUniforms(Shader& shader);
+    static void setGrade(Shader& shader, const GradeUniforms& u, const PostSettings& post, float bloomStrength);
+
+    // Post chain uniforms, resolved once in init()
+    struct PostUniforms {
+        GradeUniforms grade;
+        Uniform<glm::vec2> downsampleTexel, upsampleTexel;
+    };
+    PostUniforms m_post;
+    // Scene whose uniforms are resolved against m_lightingShader
+    Scene* m_uniformScene = nullptr;
+
+    // Frame block shared by the programs: camera, light, viewport, time, bloom
+    UniformBuffer m_frameUniforms;
+
+    unsigned int m_sceneFBO = 0;
+    unsigned int m_sceneColorTex = 0;
+    unsigned int m_sceneBrightTex = 0; // second color target: bloom source
+    unsigned int m_sceneRBO = 0;
+
+    // Bloom pyramid: level 0 is half resolution, each next level half again.
+    // Level 0 ends up with the whole glow.
+    static const int kMaxBloomLevels = 6;
+    unsigned int m_bloomFBO[kMaxBloomLevels] = {};
+    unsigned int m_bloomTex[kMaxBloomLevels] = {};
+    int m_bloomWidth[kMaxBloomLevels] = {};
+    int m_bloomHeight[kMaxBloomLevels] = {};
+    int m_bloomLevels = 0;
+
+    // 0 = default framebuffer
+    unsigned int m_outputFBO = 0;
+    unsigned int m_outputTex = 0;
+
+    // Compute post path
+    bool m_computePost = false;
+    ComputePostSettings m_computeSettings;
+    Shader m_blurCompute;
+    Shader m_gradeCompute;
+    Uniform<int> m_computeHorizontal;
+    GradeUniforms m_computeGrade;
+    unsigned int m_computeBloomTex[2] = {}; // after the row pass, after the column pass
+    // Image target standing in for the default framebuffer, blitted to it
+    unsigned int m_computeOutTex = 0;
+    unsigned int m_computeOutFBO = 0;
+
+    unsigned int m_quadVAO = 0;
+    unsigned int m_quadVBO = 0;
+};
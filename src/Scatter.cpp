@@ -0,0 +1,160 @@
+#include "Scatter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+
+uint32_t hash32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// xorshift32, one stream per tile
+struct Rng {
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 0x9e3779b9u) {}
+    float next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)(state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+// Background grid with one point per cell (cell diagonal == minDistance)
+struct Grid {
+    glm::vec2 origin;
+    float cellSize;
+    int width, height;
+    std::vector<glm::vec2> points;
+    std::vector<char> occupied; // not vector<bool>: cells are written from several threads
+
+    int cellX(float x) const { return (int)std::floor((x - origin.x) / cellSize); }
+    int cellY(float y) const { return (int)std::floor((y - origin.y) / cellSize); }
+};
+
+struct TileSampler {
+    const ScatterSettings& settings;
+    const std::function<bool(const glm::vec2&)>& accept;
+    Grid& grid;
+    int tileCells;
+
+    bool farEnough(const glm::vec2& p, int cx, int cy) const
+    {
+        const float r2 = settings.minDistance * settings.minDistance;
+        for (int y = std::max(cy - 2, 0); y <= std::min(cy + 2, grid.height - 1); y++) {
+            for (int x = std::max(cx - 2, 0); x <= std::min(cx + 2, grid.width - 1); x++) {
+                const size_t i = (size_t)y * grid.width + x;
+                if (!grid.occupied[i]) continue;
+                glm::vec2 d = grid.points[i] - p;
+                if (d.x * d.x + d.y * d.y < r2) return false;
+            }
+        }
+        return true;
+    }
+
+    void run(int tx, int ty) const
+    {
+        const int x0 = tx * tileCells, x1 = std::min(x0 + tileCells, grid.width);
+        const int y0 = ty * tileCells, y1 = std::min(y0 + tileCells, grid.height);
+        const glm::vec2 lo = grid.origin + glm::vec2((float)x0, (float)y0) * grid.cellSize;
+        const glm::vec2 hi = glm::min(grid.origin + glm::vec2((float)x1, (float)y1) * grid.cellSize, settings.max);
+        const float r = settings.minDistance;
+
+        Rng rng(hash32(settings.seed ^ hash32((uint32_t)tx * 73856093u ^ (uint32_t)ty * 19349663u)));
+        std::vector<glm::vec2> active;
+
+        // Only cells of this tile are written; reads reach at most 2 cells
+        // into the neighbouring tiles, which belong to other phases.
+        auto tryInsert = [&](const glm::vec2& p) {
+            if (p.x < lo.x || p.y < lo.y || p.x >= hi.x || p.y >= hi.y) return false;
+            const int cx = grid.cellX(p.x), cy = grid.cellY(p.y);
+            if (cx < x0 || cx >= x1 || cy < y0 || cy >= y1) return false;
+            const size_t i = (size_t)cy * grid.width + cx;
+            if (grid.occupied[i] || !farEnough(p, cx, cy)) return false;
+            if (accept && !accept(p)) return false;
+            grid.points[i] = p;
+            grid.occupied[i] = 1;
+            active.push_back(p);
+            return true;
+        };
+
+        // Darts seed every region of the tile that exclusion zones cut off,
+        // Bridson's expansion fills around each seed.
+        for (int dart = 0; dart < settings.attempts; dart++) {
+            glm::vec2 seed(lo.x + rng.next() * (hi.x - lo.x), lo.y + rng.next() * (hi.y - lo.y));
+            if (!tryInsert(seed)) continue;
+
+            while (!active.empty()) {
+                const size_t pick = std::min((size_t)(rng.next() * active.size()), active.size() - 1);
+                const glm::vec2 center = active[pick];
+                bool found = false;
+                for (int k = 0; k < settings.attempts && !found; k++) {
+                    const float angle = rng.next() * 6.28318531f;
+                    const float dist = r * (1.0f + rng.next());
+                    found = tryInsert(center + glm::vec2(std::cos(angle), std::sin(angle)) * dist);
+                }
+                if (!found) {
+                    active[pick] = active.back();
+                    active.pop_back();
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+std::vector<glm::vec2> poissonScatter(const ScatterSettings& settings,
+                                      const std::function<bool(const glm::vec2&)>& accept)
+{
+    TRACE_SCOPE("poissonScatter");
+    std::vector<glm::vec2> result;
+    const glm::vec2 extent = settings.max - settings.min;
+    if (settings.minDistance <= 0.0f || extent.x <= 0.0f || extent.y <= 0.0f) return result;
+
+    Grid grid;
+    grid.origin = settings.min;
+    grid.cellSize = settings.minDistance / std::sqrt(2.0f);
+    grid.width  = std::max(1, (int)std::ceil(extent.x / grid.cellSize));
+    grid.height = std::max(1, (int)std::ceil(extent.y / grid.cellSize));
+    grid.points.resize((size_t)grid.width * grid.height);
+    grid.occupied.assign((size_t)grid.width * grid.height, 0);
+
+    // Same-phase tiles are a whole tile (>= 2r) apart
+    const int tileCells = std::max(3, (int)std::ceil(2.0f * settings.minDistance / grid.cellSize));
+    const int tilesX = (grid.width + tileCells - 1) / tileCells;
+    const int tilesY = (grid.height + tileCells - 1) / tileCells;
+
+    TileSampler sampler = { settings, accept, grid, tileCells };
+    for (int phase = 0; phase < 4; phase++) {
+        const int px = phase & 1, py = phase >> 1;
+        const int countX = (tilesX - px + 1) / 2;
+        const int countY = (tilesY - py + 1) / 2;
+        parallelFor(countX * countY, [&](int i) {
+            sampler.run(px + 2 * (i % countX), py + 2 * (i / countX));
+        }, settings.threads);
+    }
+
+    for (size_t i = 0; i < grid.points.size(); i++) {
+        if (grid.occupied[i]) result.push_back(grid.points[i]);
+    }
+    return result;
+}
+
+float scatterRandom(unsigned int seed, unsigned int index, unsigned int channel)
+{
+    uint32_t h = hash32(seed * 0x9e3779b9u ^ hash32(index * 4u + channel));
+    return (float)(h >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Poisson-disk scatter over a rectangle: no two points closer than
+// minDistance, otherwise as dense as it gets (Bridson's algorithm).
+//
+// The area is split into tiles at least 2 * minDistance wide and processed in
+// four phases (2x2 tile colouring). Tiles of one phase never touch each other's
+// neighbourhoods, so they are sampled in parallel without locks. Every tile has
+// its own RNG stream, so the result only depends on the seed, not on the
+// thread count.
+struct ScatterSettings {
+    glm::vec2 min = glm::vec2(-1.0f);
+    glm::vec2 max = glm::vec2(1.0f);
+    float minDistance = 1.0f;
+    unsigned int seed = 1;
+    int attempts = 30;  // candidates tried around each point before giving up
+    int threads = 0;    // 0 = all cores
+};
+
+// `accept` rejects positions inside exclusion zones (may be empty). It is
+// called from several threads at once. Points come back in a fixed order.
+std::vector<glm::vec2> poissonScatter(const ScatterSettings& settings,
+                                      const std::function<bool(const glm::vec2&)>& accept);
+
+// Stable pseudo-random value in [0, 1) for a point index, for per-object variation
+float scatterRandom(unsigned int seed, unsigned int index, unsigned int channel);
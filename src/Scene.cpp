@@ -1,38 +1,16 @@
 #include "Scene.h"
+#include "GLState.h"
+#include "Trace.h"
+#include "Scatter.h"
+#include "Terrain.h"
+#include "VertexFormat.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstddef>
+#include <string>
 #include <vector>
-#define STB_IMAGE_IMPLEMENTATION
 #include <iostream>
-#include <stb_image.h>
 
-static unsigned int loadTexture2D(const std::string& path)
-{
-    unsigned int tex = 0;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    // wrapping + filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_set_flip_vertically_on_load(true);
-
-    int w, h, n;
-    unsigned char* data = stbi_load(path.c_str(), &w, &h, &n, 0);
-    if (!data) {
-        std::cout << "Failed to load texture: " << path << "\n";
-        return 0;
-    }
-
-    GLenum format = (n == 4) ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-    return tex;
-}
 // Cube (same layout you already use): pos(3) + normal(3)
 static float kCubeVertices[] = {
     // back
@@ -84,169 +62,92 @@ static float kCubeVertices[] = {
     -0.5f, 0.5f, 0.5f,  0, 1,0
 };
 
-// Big plane, same layout: pos(3) + normal(3)
-static float kPlaneVertices[] = {
-    -1,0,-1,  0,1,0,
-     1,0,-1,  0,1,0,
-     1,0, 1,  0,1,0,
-
-     1,0, 1,  0,1,0,
-    -1,0, 1,  0,1,0,
-    -1,0,-1,  0,1,0
-};
-
-static float heightAt(float x, float z)
+// River centre line: sine meander along z
+static float riverCenterX(float z)
 {
-    const float amp  = 0.35f;   // hill height
-    const float freq = 0.35f;   // hill frequency
-    return amp * std::sin(x * freq) * std::cos(z * freq);
+    return 3.0f * std::sin(z * 0.25f);
 }
 
-
-static glm::vec3 normalAt(float x, float z)
+// derivative of 3*sin(0.25z) => 3*0.25*cos(0.25z)
+static float riverCenterDxDz(float z)
 {
-    const float eps = 0.05f;
-    float hL = heightAt(x - eps, z);
-    float hR = heightAt(x + eps, z);
-    float hD = heightAt(x, z - eps);
-    float hU = heightAt(x, z + eps);
-
-    // slope vectors
-    glm::vec3 dx(2.0f * eps, hR - hL, 0.0f);
-    glm::vec3 dz(0.0f, hU - hD, 2.0f * eps);
-
-    glm::vec3 n = glm::normalize(glm::cross(dz, dx));
-    return n;
+    return 0.75f * std::cos(z * 0.25f);
 }
 
+// Layers of mMaterialTex; the index is what uMaterial / the instance color's
+// alpha select. The lighting shader's table holds up to kMaxMaterials.
+enum Material { MaterialGrass, MaterialWater, MaterialRock, MaterialBark, MaterialLeaf, MaterialCount };
+static_assert(MaterialCount <= kMaxMaterials, "Materials block is too small");
 
-void Scene::init() {
-    // Cube
-    glGenVertexArrays(1, &mCubeVAO);
-    glGenBuffers(1, &mCubeVBO);
-    glBindVertexArray(mCubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, mCubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(kCubeVertices), kCubeVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    mTexGrass = loadTexture2D(std::string(PROJECT_SOURCE_DIR) + "/src/textures/grass.jpg");
-    mTexWater = loadTexture2D(std::string(PROJECT_SOURCE_DIR) + "/src/textures/water.jpg");
-    mTexRock  = loadTexture2D(std::string(PROJECT_SOURCE_DIR) + "/src/textures/rock.jpg");
-    mTexBark  = loadTexture2D(std::string(PROJECT_SOURCE_DIR) + "/src/textures/bark.jpg");
-    mTexLeaf  = loadTexture2D(std::string(PROJECT_SOURCE_DIR) + "/src/textures/leaves.jpg");
-
-
-    // Plane
-    glGenVertexArrays(1, &mPlaneVAO);
-    glGenBuffers(1, &mPlaneVBO);
-    glBindVertexArray(mPlaneVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, mPlaneVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(kPlaneVertices), kPlaneVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
-    // --- Hills ground mesh (grid) ---
-    const int N = 120;              // grid resolution (try 80–200)
-    const float size = 40.0f;       // world size (matches your earlier scale)
-    const float half = size * 0.5f;
-
-    std::vector<float> verts;       // pos(3) + normal(3)
-    std::vector<unsigned int> idx;
-
-    verts.reserve(N * N * 6);
-
-    for (int z = 0; z < N; z++) {
-        for (int x = 0; x < N; x++) {
-            float u = (float)x / (N - 1);
-            float v = (float)z / (N - 1);
-
-            float worldX = -half + u * size;
-            float worldZ = -half + v * size;
-
-            float y = heightAt(worldX, worldZ);
-            glm::vec3 n = normalAt(worldX, worldZ);
-
-            verts.push_back(worldX);
-            verts.push_back(y);
-            verts.push_back(worldZ);
-
-            verts.push_back(n.x);
-            verts.push_back(n.y);
-            verts.push_back(n.z);
-        }
-    }
-
-    // indices (two triangles per cell)
-    for (int z = 0; z < N - 1; z++) {
-        for (int x = 0; x < N - 1; x++) {
-            unsigned int i0 = (unsigned int)(z * N + x);
-            unsigned int i1 = i0 + 1;
-            unsigned int i2 = i0 + (unsigned int)N;
-            unsigned int i3 = i2 + 1;
-
-            // triangle 1
-            idx.push_back(i0);
-            idx.push_back(i2);
-            idx.push_back(i1);
-
-            // triangle 2
-            idx.push_back(i1);
-            idx.push_back(i2);
-            idx.push_back(i3);
-        }
-    }
+struct MaterialDesc {
+    const char* file;
+    glm::vec3 placeholder; // shown until the image is loaded, roughly its average
+    glm::vec3 tint;
+    glm::vec2 texScale;    // triplanar UVs per world unit
+};
 
-    mGroundIndexCount = (int)idx.size();
+static const MaterialDesc kMaterials[MaterialCount] = {
+    { "grass.jpg",  glm::vec3(0.33f, 0.42f, 0.18f), glm::vec3(0.55f, 0.55f, 0.18f), glm::vec2(1.5f) },
+    { "water.jpg",  glm::vec3(0.16f, 0.34f, 0.45f), glm::vec3(0.08f, 0.35f, 0.65f), glm::vec2(2.5f) },
+    { "rock.jpg",   glm::vec3(0.45f, 0.43f, 0.41f), glm::vec3(0.45f, 0.45f, 0.48f), glm::vec2(1.0f) },
+    { "bark.jpg",   glm::vec3(0.32f, 0.24f, 0.17f), glm::vec3(0.35f, 0.22f, 0.12f), glm::vec2(2.5f) },
+    { "leaves.jpg", glm::vec3(0.22f, 0.36f, 0.14f), glm::vec3(0.10f, 0.45f, 0.12f), glm::vec2(1.5f) },
+};
 
-    glGenVertexArrays(1, &mGroundVAO);
-    glGenBuffers(1, &mGroundVBO);
-    glGenBuffers(1, &mGroundEBO);
+// Every material is resampled to this size to share the array
+const int kMaterialLayerSize = 1024;
 
-    glBindVertexArray(mGroundVAO);
+const float kRiverZMin = -18.0f;
+const float kRiverZMax =  18.0f;
+const float kRiverHalfWidth = 1.6f;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mGroundVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
+// Area that gets vegetation (the terrain itself is much larger)
+const float kScatterSize = 40.0f;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mGroundEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(unsigned int), idx.data(), GL_STATIC_DRAW);
+void Scene::init(const SceneSettings& settings) {
+    TRACE_SCOPE("Scene::init");
+    // Cube mesh, shared by the instance batches (each sets up its own VAO)
+    glGenBuffers(1, &mCubeVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, mCubeVBO);
+    std::vector<PackedVertex> packed;
+    packVertices(kCubeVertices, sizeof(kCubeVertices) / (6 * sizeof(float)), packed);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+
+    // Material textures decode in the background; until then each layer
+    // shows its placeholder color
+    const std::string textureDir = std::string(PROJECT_SOURCE_DIR) + "/src/textures/";
+    mTextureLoader.init(0, settings.textureCache ? std::string(PROJECT_SOURCE_DIR) + "/texture_cache" : std::string(),
+                        settings.compressTextures);
+    mMaterialTex = mTextureLoader.createArray(kMaterialLayerSize, MaterialCount);
+    for (int m = 0; m < MaterialCount; m++) {
+        mTextureLoader.loadLayer(mMaterialTex, m, textureDir + kMaterials[m].file, kMaterials[m].placeholder);
+    }
 
-    // layout: location 0 = position, location 1 = normal
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // The material table never changes after this
+    MaterialUniforms materials = MaterialUniforms();
+    for (int m = 0; m < MaterialCount; m++) {
+        materials.tint[m] = glm::vec4(kMaterials[m].tint, 1.0f);
+        materials.scale[m] = glm::vec4(kMaterials[m].texScale, 0.0f, 0.0f);
+    }
+    mMaterialUniforms.init(MaterialBinding, sizeof(MaterialUniforms));
+    mMaterialUniforms.update(&materials, sizeof(materials));
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    GLState::bindVertexArray(0);
+    // --- Hills: chunked LOD terrain ---
+    mTerrain.init(settings.terrain);
 
-    glBindVertexArray(0);
     // --- River ribbon mesh ---
 {
     const int S = 220;          // samples along the river (smoothness)
-    const float zMin = -18.0f;
-    const float zMax =  18.0f;
+    const float zMin = kRiverZMin;
+    const float zMax = kRiverZMax;
 
-    const float halfWidth = 1.6f;   // half river width
+    const float halfWidth = kRiverHalfWidth;
     const float yOffset   = 0.03f;  // lift slightly above ground to avoid z-fighting
 
-    // vertex layout = pos(3) + normal(3) like your shaders expect
-    std::vector<float> rv;
-    rv.reserve(S * 2 * 6); // 2 verts per sample, 6 floats per vert
-
-    auto riverCenterX = [](float z) {
-        // Simple curve: sine meander
-        return 3.0f * std::sin(z * 0.25f);
-    };
-
-    auto riverCenterDxDz = [](float z) {
-        // derivative of 3*sin(0.25z) => 3*0.25*cos(0.25z)
-        return 0.75f * std::cos(z * 0.25f);
-    };
+    // 2 verts per sample, float pos + packed normal
+    std::vector<PackedVertex> rv;
+    rv.reserve(S * 2);
 
     for (int i = 0; i < S; i++) {
         float t = (float)i / (float)(S - 1);
@@ -266,23 +167,16 @@ void Scene::init() {
         glm::vec2 leftXZ  = glm::vec2(x, z) + perp * halfWidth;
         glm::vec2 rightXZ = glm::vec2(x, z) - perp * halfWidth;
 
-        float yL = heightAt(leftXZ.x,  leftXZ.y)  + yOffset;
-        float yR = heightAt(rightXZ.x, rightXZ.y) + yOffset;
+        float yL = Terrain::heightAt(leftXZ.x,  leftXZ.y)  + yOffset;
+        float yR = Terrain::heightAt(rightXZ.x, rightXZ.y) + yOffset;
 
         // Normals: for water you can just use up (looks fine for now)
-        glm::vec3 n(0,1,0);
-
-        // left vertex
-        rv.push_back(leftXZ.x);
-        rv.push_back(yL);
-        rv.push_back(leftXZ.y);
-        rv.push_back(n.x); rv.push_back(n.y); rv.push_back(n.z);
-
-        // right vertex
-        rv.push_back(rightXZ.x);
-        rv.push_back(yR);
-        rv.push_back(rightXZ.y);
-        rv.push_back(n.x); rv.push_back(n.y); rv.push_back(n.z);
+        const uint32_t n = packNormal(glm::vec3(0, 1, 0));
+
+        PackedVertex left  = { { leftXZ.x,  yL, leftXZ.y },  n };
+        PackedVertex right = { { rightXZ.x, yR, rightXZ.y }, n };
+        rv.push_back(left);
+        rv.push_back(right);
     }
 
     mRiverVertexCount = S * 2;
@@ -290,168 +184,244 @@ void Scene::init() {
     glGenVertexArrays(1, &mRiverVAO);
     glGenBuffers(1, &mRiverVBO);
 
-    glBindVertexArray(mRiverVAO);
+    GLState::bindVertexArray(mRiverVAO);
     glBindBuffer(GL_ARRAY_BUFFER, mRiverVBO);
-    glBufferData(GL_ARRAY_BUFFER, rv.size() * sizeof(float), rv.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, rv.size() * sizeof(PackedVertex), rv.data(), GL_STATIC_DRAW);
+    setVertexAttribs(VertexPosPackedNormal);
+
+    GLState::bindVertexArray(0);
+}
+
+    // -------------------------
+    // Trees and rocks (instanced)
+    // -------------------------
+    scatterVegetation(settings);
+    uploadBatch(mVegetation);
+}
+
+// Poisson-disk scatter over the ground, keeping clear of the river and the
+// terrain edge. Objects sit on Terrain::heightAt(), sunk a little so no corner floats
+// on slopes.
+void Scene::scatterVegetation(const SceneSettings& settings)
+{
+    TRACE_SCOPE("Scene::scatterVegetation");
+    const float margin = 1.0f;
+    const float half = kScatterSize * 0.5f - margin;
+
+    ScatterSettings scatter;
+    scatter.min = glm::vec2(-half);
+    scatter.max = glm::vec2(half);
+    scatter.minDistance = settings.vegetationSpacing;
+    scatter.seed = settings.seed;
+
+    const float riverClearance = kRiverHalfWidth + 1.2f; // half a crown beyond the bank
+    std::vector<glm::vec2> points = poissonScatter(scatter, [&](const glm::vec2& p) {
+        if (p.y < kRiverZMin - riverClearance || p.y > kRiverZMax + riverClearance) return true;
+        return std::fabs(p.x - riverCenterX(p.y)) > riverClearance;
+    });
+
+    mVegetation.instances.reserve(points.size() * 4);
+    for (size_t i = 0; i < points.size(); i++) {
+        const unsigned int id = (unsigned int)i;
+        const float x = points[i].x, z = points[i].y;
+        const float y = Terrain::heightAt(x, z);
+
+        if (scatterRandom(settings.seed, id, 0) < settings.rockFraction) {
+            glm::vec3 scale(0.9f + 0.7f * scatterRandom(settings.seed, id, 1),
+                            0.6f + 0.3f * scatterRandom(settings.seed, id, 2),
+                            0.7f + 0.5f * scatterRandom(settings.seed, id, 3));
+            addRock(glm::vec3(x, y - 0.15f * scale.y, z), scale);
+        } else {
+            float trunkH = 2.4f + 0.8f * scatterRandom(settings.seed, id, 1);
+            float crownSize = 1.7f + 0.5f * scatterRandom(settings.seed, id, 2);
+            addTree(glm::vec3(x, y - 0.15f, z), trunkH, crownSize);
+        }
+    }
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+void Scene::addTree(const glm::vec3& pos, float trunkH, float crownSize)
+{
+    CubeInstance trunk;
+    trunk.model = glm::mat4(1.0f);
+    trunk.model = glm::translate(trunk.model, pos + glm::vec3(0, trunkH * 0.5f, 0));
+    trunk.model = glm::scale(trunk.model, glm::vec3(0.4f, trunkH, 0.4f));
+    trunk.color = glm::vec4(1.0f, 1.0f, 1.0f, (float)MaterialBark);
+    mVegetation.instances.push_back(trunk);
+
+    for (int i = 0; i < 3; i++) {
+        float y = trunkH + (float)i * (crownSize * 0.45f);
+        float s = crownSize * (1.0f - 0.18f * i);
+        CubeInstance crown;
+        crown.model = glm::mat4(1.0f);
+        crown.model = glm::translate(crown.model, pos + glm::vec3(0, y, 0));
+        crown.model = glm::scale(crown.model, glm::vec3(s, s, s));
+        crown.color = glm::vec4(1.0f, 1.0f, 1.0f, (float)MaterialLeaf);
+        mVegetation.instances.push_back(crown);
+    }
+}
+
+void Scene::addRock(const glm::vec3& pos, const glm::vec3& scale)
+{
+    CubeInstance rock;
+    rock.model = glm::mat4(1.0f);
+    rock.model = glm::translate(rock.model, pos + glm::vec3(0, scale.y * 0.5f, 0));
+    rock.model = glm::scale(rock.model, scale);
+    rock.color = glm::vec4(1.0f, 1.0f, 1.0f, (float)MaterialRock);
+    mVegetation.instances.push_back(rock);
+}
+
+// Cube vertices from mCubeVBO plus a per-instance buffer (divisor 1), and the
+// culling grid over the instance bounds
+void Scene::uploadBatch(InstanceBatch& batch)
+{
+    std::vector<Aabb> bounds(batch.instances.size());
+    for (size_t i = 0; i < batch.instances.size(); i++) {
+        // unit cube corners are +-0.5: extent = 0.5 * |upper 3x3| * (1,1,1)
+        const glm::mat4& m = batch.instances[i].model;
+        glm::vec3 center(m[3][0], m[3][1], m[3][2]);
+        glm::vec3 extent(
+            0.5f * (std::fabs(m[0][0]) + std::fabs(m[1][0]) + std::fabs(m[2][0])),
+            0.5f * (std::fabs(m[0][1]) + std::fabs(m[1][1]) + std::fabs(m[2][1])),
+            0.5f * (std::fabs(m[0][2]) + std::fabs(m[1][2]) + std::fabs(m[2][2])));
+        bounds[i].min = center - extent;
+        bounds[i].max = center + extent;
+    }
+    batch.grid.build(bounds, 8.0f);
 
-    glBindVertexArray(0);
+    if (batch.vao == 0) {
+        glGenVertexArrays(1, &batch.vao);
+        glGenBuffers(1, &batch.vbo);
+    }
+    GLState::bindVertexArray(batch.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mCubeVBO);
+    setVertexAttribs(VertexPosPackedNormal);
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    glBufferData(GL_ARRAY_BUFFER, batch.instances.size() * sizeof(CubeInstance),
+                 batch.instances.empty() ? nullptr : batch.instances.data(), GL_STREAM_DRAW);
+
+    const GLsizei stride = sizeof(CubeInstance);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(CubeInstance, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    for (int c = 0; c < 4; c++) {
+        GLuint loc = (GLuint)(3 + c);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(offsetof(CubeInstance, model) + c * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(loc);
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    GLState::bindVertexArray(0);
 }
 
+void Scene::destroyBatch(InstanceBatch& batch)
+{
+    if (batch.vbo) glDeleteBuffers(1, &batch.vbo);
+    if (batch.vao) GLState::deleteVertexArrays(1, &batch.vao);
+    batch.vbo = batch.vao = 0;
+    batch.instances.clear();
+    batch.grid.clear();
+}
+
+void Scene::drawBatch(InstanceBatch& batch, const Frustum& frustum)
+{
+    batch.visibleIds.clear();
+    batch.grid.query(frustum, batch.visibleIds, mCullStats);
+    if (batch.visibleIds.empty()) return;
+
+    batch.visible.resize(batch.visibleIds.size());
+    for (size_t i = 0; i < batch.visibleIds.size(); i++) {
+        batch.visible[i] = batch.instances[batch.visibleIds[i]];
+    }
+
+    // Orphan the buffer so the driver doesn't wait on last frame's draw
+    const GLsizeiptr bytes = (GLsizeiptr)(batch.visible.size() * sizeof(CubeInstance));
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, batch.visible.data());
+
+    GLState::bindVertexArray(batch.vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)batch.visible.size());
 }
 
 void Scene::destroy() {
     if (mCubeVBO) glDeleteBuffers(1, &mCubeVBO);
-    if (mCubeVAO) glDeleteVertexArrays(1, &mCubeVAO);
-    if (mPlaneVBO) glDeleteBuffers(1, &mPlaneVBO);
-    if (mPlaneVAO) glDeleteVertexArrays(1, &mPlaneVAO);
-    mCubeVBO = mCubeVAO = mPlaneVBO = mPlaneVAO = 0;
-    if (mGroundEBO) glDeleteBuffers(1, &mGroundEBO);
-    if (mGroundVBO) glDeleteBuffers(1, &mGroundVBO);
-    if (mGroundVAO) glDeleteVertexArrays(1, &mGroundVAO);
-    mGroundEBO = mGroundVBO = mGroundVAO = 0;
-    mGroundIndexCount = 0;
+    mCubeVBO = 0;
+    mTerrain.destroy();
+    mTextureLoader.destroy();
+    destroyBatch(mVegetation);
     if (mRiverVBO) glDeleteBuffers(1, &mRiverVBO);
-    if (mRiverVAO) glDeleteVertexArrays(1, &mRiverVAO);
+    if (mRiverVAO) GLState::deleteVertexArrays(1, &mRiverVAO);
     mRiverVBO = mRiverVAO = 0;
     mRiverVertexCount = 0;
-    if (mTexGrass) glDeleteTextures(1, &mTexGrass);
-    if (mTexWater) glDeleteTextures(1, &mTexWater);
-    if (mTexRock)  glDeleteTextures(1, &mTexRock);
-    if (mTexBark)  glDeleteTextures(1, &mTexBark);
-    if (mTexLeaf)  glDeleteTextures(1, &mTexLeaf);
-
-    mTexGrass = mTexWater = mTexRock = mTexBark = mTexLeaf = 0;
+    if (mMaterialTex) GLState::deleteTextures(1, &mMaterialTex);
+    mMaterialTex = 0;
+    mMaterialUniforms.destroy();
 
 
 }
 
-void Scene::drawCube(Shader& shader, const glm::mat4& model, const glm::vec3& color) {
-    shader.setMat4("uModel", model);
-    shader.setVec3("uObjectColor", color);
-    glBindVertexArray(mCubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-}
-
-void Scene::drawPlane(Shader& shader, const glm::mat4& model, const glm::vec3& color) {
-    shader.setMat4("uModel", model);
-    shader.setVec3("uObjectColor", color);
-    glBindVertexArray(mPlaneVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+void Scene::resolveUniforms(Shader& shader)
+{
+    mUniforms.instanced = shader.uniform<int>("uInstanced");
+    mUniforms.material = shader.uniform<int>("uMaterial");
+    mUniforms.model = shader.uniform<glm::mat4>("uModel");
+    mUniforms.objectColor = shader.uniform<glm::vec3>("uObjectColor");
+    mTerrain.resolveUniforms(shader);
 }
 
 void Scene::render(Shader& shader,
                    const glm::mat4& view,
-                   const glm::mat4& proj,
-                   const glm::vec3& lightPos)
+                   const glm::mat4& proj)
 {
+    TRACE_SCOPE("Scene::render");
+    mTextureLoader.poll();
     shader.use();
-    shader.setInt("uTex", 0);
-    shader.setMat4("uView", view);
-    shader.setMat4("uProj", proj);
-    shader.setVec3("uLightPos", lightPos);
-    shader.setVec3("uLightColor", glm::vec3(1.0f));
+    const Uniform<int> instanced = mUniforms.instanced;
+    const Uniform<int> material = mUniforms.material;
+    const Uniform<glm::mat4> model = mUniforms.model;
+    shader.set(instanced, 0);
+
+    // Materials: one texture array and uniform block for the whole scene,
+    // draws only pick a layer
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, mMaterialTex);
+    shader.set(mUniforms.objectColor, glm::vec3(1.0f));
+
+    const Frustum frustum(proj * view);
+    const glm::vec3 eye(glm::inverse(view)[3]);
 
     // -------------------------
     // Grass floor
     // -------------------------
     glm::mat4 ground = glm::mat4(1.0f);
-    shader.setMat4("uModel", ground);
-    shader.setVec3("uObjectColor", glm::vec3(0.55f, 0.55f, 0.18f));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mTexGrass);
-    shader.setVec2("uTexScale", glm::vec2(1.5f));
-    shader.setInt("uUseTexture", 1);
-
-    glBindVertexArray(mGroundVAO);
-    glDrawElements(GL_TRIANGLES, mGroundIndexCount, GL_UNSIGNED_INT, 0);
-    shader.setInt("uUseTexture", 0);
-
+    shader.set(model, ground);
+    shader.set(material, MaterialGrass);
+    mTerrain.render(shader, eye, frustum);
 
     /// -------------------------
     // River 
     // -------------------------
-    shader.setMat4("uModel", glm::mat4(1.0f));
-    shader.setVec3("uObjectColor", glm::vec3(0.08f, 0.35f, 0.65f));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mTexWater);
-    shader.setInt("uUseTexture", 1);
-    shader.setVec2("uTexScale", glm::vec2(2.5f));
+    shader.set(model, glm::mat4(1.0f));
+    shader.set(material, MaterialWater);
 
-    glBindVertexArray(mRiverVAO);
+    GLState::bindVertexArray(mRiverVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, mRiverVertexCount);
-    shader.setInt("uUseTexture", 0);
 
     // -------------------------
-    // A few trees
+    // Trees and rocks: one instanced draw, frustum culled; each instance
+    // carries its material
     // -------------------------
+    mCullStats = CullGrid::Stats();
 
-    auto drawTree = [&](glm::vec3 pos, float trunkH, float crownSize) {
-        // trunk
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mTexBark);
-        shader.setVec2("uTexScale", glm::vec2(2.5f));
-        shader.setInt("uUseTexture", 1);
-        shader.setVec3("uObjectColor", glm::vec3(1.0f));
-        glm::mat4 trunk = glm::mat4(1.0f);
-        trunk = glm::translate(trunk, pos + glm::vec3(0, trunkH * 0.5f, 0));
-        trunk = glm::scale(trunk, glm::vec3(0.4f, trunkH, 0.4f));
-        drawCube(shader, trunk, glm::vec3(0.35f, 0.22f, 0.12f));
-        shader.setInt("uUseTexture", 0);
-
-        // crown
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mTexLeaf);
-        shader.setVec2("uTexScale", glm::vec2(1.5f));
-        shader.setInt("uUseTexture", 1);
-        shader.setVec3("uObjectColor", glm::vec3(1.0f));
-        for (int i = 0; i < 3; i++) {
-            float y = trunkH + (float)i * (crownSize * 0.45f);
-            glm::mat4 crown = glm::mat4(1.0f);
-            crown = glm::translate(crown, pos + glm::vec3(0, y, 0));
-            float s = crownSize * (1.0f - 0.18f * i);
-            crown = glm::scale(crown, glm::vec3(s, s, s));
-            drawCube(shader, crown, glm::vec3(0.10f, 0.45f, 0.12f));
-        }
-        shader.setInt("uUseTexture", 0);
-    };
-
-    drawTree(glm::vec3(-5.0f, 0, -4.5f), 2.6f, 1.8f);
-    drawTree(glm::vec3(-1.2f, 0, -5.0f), 3.2f, 2.2f);
-    drawTree(glm::vec3( 1.2f, 0, -1.2f), 2.8f, 2.0f);
-    drawTree(glm::vec3( 2.6f, 0, -5.0f), 2.4f, 1.7f);
-    drawTree(glm::vec3( 0.5f, 0, -6.8f), 2.9f, 2.0f);
-    // drawTree(glm::vec3(-2.2f, 0, -6.3f), 2.5f, 1.8f);
+    shader.set(instanced, 1);
+    drawBatch(mVegetation, frustum);
+    shader.set(instanced, 0);
 
-    // -------------------------
-    // Rocks
-    // -------------------------
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mTexRock);
-    shader.setVec2("uTexScale", glm::vec2(1.0f));
-    shader.setInt("uUseTexture", 1);
-    shader.setVec3("uObjectColor", glm::vec3(4.0f, 4.0f, 4.0f)); // HDR bright
-
-
-    auto drawRock = [&](glm::vec3 pos, glm::vec3 scale) {
-        glm::mat4 m = glm::mat4(1.0f);
-        m = glm::translate(m, pos + glm::vec3(0, scale.y * 0.5f, 0));
-        m = glm::scale(m, scale);
-        drawCube(shader, m, glm::vec3(0.45f, 0.45f, 0.48f));
-    };
-
-    drawRock(glm::vec3(3,0,-4), glm::vec3(1.6f, 0.8f, 1.2f));
-    drawRock(glm::vec3(5,0,-3), glm::vec3(0.9f, 0.6f, 0.7f));
-    drawRock(glm::vec3(-8,0, 2), glm::vec3(1.2f, 0.7f, 1.1f));
-
-    glBindVertexArray(0);
-    shader.setInt("uUseTexture", 0);
+    GLState::bindVertexArray(0);
+    shader.set(material, -1);
 }
 
 
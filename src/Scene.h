@@ -1,37 +1,98 @@
 #pragma once
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <vector>
 #include "Shader.h"
+#include "Culling.h"
+#include "Terrain.h"
+#include "TextureLoader.h"
+#include "UniformBuffer.h"
+
+// Scene generation parameters
+struct SceneSettings {
+    // Poisson-disk spacing of trees and rocks in world units; smaller = denser
+    // (roughly 0.65 / spacing^2 objects per square unit)
+    float vegetationSpacing = 2.8f;
+    // share of the scattered points that become rocks instead of trees
+    float rockFraction = 0.15f;
+    unsigned int seed = 1;
+    TerrainSettings terrain;
+    // Keep decoded textures with their mips under <project>/texture_cache
+    bool textureCache = true;
+    // BC1 textures (8x smaller than RGBA8) where the GL supports S3TC
+    bool compressTextures = false;
+};
 
 class Scene {
 public:
-    void init();
+    void init(const SceneSettings& settings = SceneSettings());
     void destroy();
 
+    // Blocks until every texture has its real image (they load in the
+    // background and show a placeholder color meanwhile)
+    void finishLoading() { mTextureLoader.flush(); }
+
+    // Looks up the uniforms render() sets in `shader`, the terrain's too.
+    // Once per program, before the first render() with it (Renderer does).
+    void resolveUniforms(Shader& shader);
+
     // Draw the whole scene (floor, trees, rocks)
+    // (camera and light come from the Frame uniform block)
     void render(Shader& shader,
                 const glm::mat4& view,
-                const glm::mat4& proj,
-                const glm::vec3& lightPos);
+                const glm::mat4& proj);
+
+    // Instances that passed / failed frustum culling in the last render()
+    const CullGrid::Stats& cullStats() const { return mCullStats; }
+    const Terrain::Stats& terrainStats() const { return mTerrain.stats(); }
 
 private:
-    unsigned int mCubeVAO = 0, mCubeVBO = 0;
-    unsigned int mPlaneVAO = 0, mPlaneVBO = 0;
-    unsigned int mGroundVAO = 0;
-    unsigned int mGroundVBO = 0;
-    unsigned int mGroundEBO = 0;
-    int mGroundIndexCount = 0;
+    // One cube per instance; layout matches the lighting shader's
+    // aInstColor (location 2) and aInstModel (locations 3..6)
+    struct CubeInstance {
+        glm::mat4 model;
+        glm::vec4 color; // rgb multiplies the material tint, a = material layer
+    };
+
+    // Instances drawn with one glDrawArraysInstanced; each picks its own
+    // material. Only the instances that survive frustum culling are
+    // streamed to vbo.
+    struct InstanceBatch {
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        std::vector<CubeInstance> instances;
+        CullGrid grid;
+        std::vector<unsigned int> visibleIds; // per-frame scratch
+        std::vector<CubeInstance> visible;    // per-frame scratch
+    };
+
+    unsigned int mCubeVBO = 0; // unit cube, the instance batches' mesh
+    Terrain mTerrain;
     unsigned int mRiverVAO = 0;
     unsigned int mRiverVBO = 0;
     int mRiverVertexCount = 0; 
-    unsigned int mTexGrass = 0;
-    unsigned int mTexWater = 0;
-    unsigned int mTexRock  = 0;
-    unsigned int mTexBark  = 0;
-    unsigned int mTexLeaf  = 0;
+    unsigned int mMaterialTex = 0; // GL_TEXTURE_2D_ARRAY, one layer per material
+    TextureLoader mTextureLoader;
+    UniformBuffer mMaterialUniforms; // tint and scale per layer, written at init
+
+    // Trees and rocks
+    InstanceBatch mVegetation;
+    CullGrid::Stats mCullStats;
+
+    // Lighting program uniforms, from resolveUniforms()
+    struct Uniforms {
+        Uniform<int> instanced, material;
+        Uniform<glm::mat4> model;
+        Uniform<glm::vec3> objectColor;
+    };
+    Uniforms mUniforms;
 
 
 private:
-    void drawCube(Shader& shader, const glm::mat4& model, const glm::vec3& color);
-    void drawPlane(Shader& shader, const glm::mat4& model, const glm::vec3& color);
+    void addTree(const glm::vec3& pos, float trunkH, float crownSize);
+    void addRock(const glm::vec3& pos, const glm::vec3& scale);
+    void scatterVegetation(const SceneSettings& settings);
+    void uploadBatch(InstanceBatch& batch);
+    void destroyBatch(InstanceBatch& batch);
+    void drawBatch(InstanceBatch& batch, const Frustum& frustum);
 };
@@ -1,6 +1,10 @@
 #include "Shader.h"
+#include "GLState.h"
+#include "Trace.h"
 
 #include <glad/glad.h>
+#include <cassert>
+#include <cstring>
 #include <iostream>
 #include <utility>
 #include <fstream>
@@ -38,12 +42,41 @@ Shader::Shader(const char* vertexSrc, const char* fragmentSrc) {
     glDeleteShader(fs);
 }
 
+Shader Shader::compute(const char* computeSrc) {
+#ifdef GL_VERSION_4_3
+    Shader shader;
+    unsigned int cs = shader.compile(GL_COMPUTE_SHADER, computeSrc);
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, cs);
+    glLinkProgram(program);
+    glDeleteShader(cs);
+
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info[1024];
+        glGetProgramInfoLog(program, sizeof(info), nullptr, info);
+        std::cerr << "Shader link error:\n" << info << "\n";
+        glDeleteProgram(program);
+        return shader;
+    }
+    shader.m_id = program;
+    return shader;
+#else
+    (void)computeSrc;
+    return Shader();
+#endif
+}
+
 Shader::~Shader() {
     destroy();
 }
 
 Shader::Shader(Shader&& other) noexcept
-    : m_id(other.m_id), m_uniformCache(std::move(other.m_uniformCache)) {
+    : m_id(other.m_id), m_uniformCache(std::move(other.m_uniformCache)),
+      m_handleCache(std::move(other.m_handleCache)), m_slots(std::move(other.m_slots)),
+      m_values(std::move(other.m_values)) {
     other.m_id = 0;
 }
 
@@ -52,6 +85,9 @@ Shader& Shader::operator=(Shader&& other) noexcept {
         destroy();
         m_id = other.m_id;
         m_uniformCache = std::move(other.m_uniformCache);
+        m_handleCache = std::move(other.m_handleCache);
+        m_slots = std::move(other.m_slots);
+        m_values = std::move(other.m_values);
         other.m_id = 0;
     }
     return *this;
@@ -59,10 +95,13 @@ Shader& Shader::operator=(Shader&& other) noexcept {
 
 void Shader::destroy() {
     if (m_id != 0) {
-        glDeleteProgram(m_id);
+        GLState::deleteProgram(m_id);
         m_id = 0;
     }
     m_uniformCache.clear();
+    m_handleCache.clear();
+    m_slots.clear();
+    m_values.clear();
 }
 
 unsigned int Shader::compile(unsigned int type, const char* src) {
@@ -75,43 +114,129 @@ unsigned int Shader::compile(unsigned int type, const char* src) {
     if (!success) {
         char info[1024];
         glGetShaderInfoLog(sh, sizeof(info), nullptr, info);
-        std::cerr << (type == GL_VERTEX_SHADER ? "Vertex" : "Fragment")
-                  << " shader compile error:\n" << info << "\n";
+        const char* kind = type == GL_VERTEX_SHADER ? "Vertex"
+                         : type == GL_FRAGMENT_SHADER ? "Fragment" : "Compute";
+        std::cerr << kind << " shader compile error:\n" << info << "\n";
     }
     return sh;
 }
 
 void Shader::use() const {
-    glUseProgram(m_id);
+    GLState::useProgram(m_id);
 }
 
-int Shader::uniformLocation(const std::string& name) {
-    std::unordered_map<std::string, int>::iterator it = m_uniformCache.find(name);
+const std::pair<int, int>& Shader::uniformLocation(const std::string& name) {
+    std::unordered_map<std::string, std::pair<int, int> >::iterator it = m_uniformCache.find(name);
     if (it != m_uniformCache.end()) {
         return it->second;
     }
 
     int loc = glGetUniformLocation(m_id, name.c_str());
-    m_uniformCache[name] = loc;
+    return m_uniformCache[name] = std::make_pair(loc, slot(loc));
+}
+
+int Shader::slot(int location) {
+    if (location < 0) return -1;
+    std::unordered_map<int, int>::iterator it = m_slots.find(location);
+    if (it != m_slots.end()) return it->second;
+
+    const int s = (int)m_values.size();
+    m_values.push_back(UniformValue());
+    m_slots[location] = s;
+    return s;
+}
+
+int Shader::handleLocation(const UniformName& name) {
+    std::unordered_map<uint32_t, std::pair<std::string, int> >::iterator it = m_handleCache.find(name.hash);
+    if (it != m_handleCache.end()) {
+        if (it->second.first == name.str) return it->second.second;
+        // Two names with one hash: correct but uncached
+        std::cerr << "Uniform hash collision: " << name.str << " / " << it->second.first << "\n";
+        return glGetUniformLocation(m_id, name.str);
+    }
+
+    int loc = glGetUniformLocation(m_id, name.str);
+    m_handleCache[name.hash] = std::make_pair(std::string(name.str), loc);
     return loc;
 }
 
 void Shader::setInt(const std::string& name, int v) {
-    glUniform1i(uniformLocation(name), v);
+    TRACE_SCOPE("Shader::setInt");
+    const std::pair<int, int>& u = uniformLocation(name);
+    set(Uniform<int>(u.first, u.second), v);
 }
 
 void Shader::setFloat(const std::string& name, float v) {
-    glUniform1f(uniformLocation(name), v);
+    TRACE_SCOPE("Shader::setFloat");
+    const std::pair<int, int>& u = uniformLocation(name);
+    set(Uniform<float>(u.first, u.second), v);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& v) {
-    glUniform3f(uniformLocation(name), v.x, v.y, v.z);
+    TRACE_SCOPE("Shader::setVec3");
+    const std::pair<int, int>& u = uniformLocation(name);
+    set(Uniform<glm::vec3>(u.first, u.second), v);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& m) {
-    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &m[0][0]);
+    TRACE_SCOPE("Shader::setMat4");
+    const std::pair<int, int>& u = uniformLocation(name);
+    set(Uniform<glm::mat4>(u.first, u.second), m);
 }
 void Shader::setVec2(const std::string& name, const glm::vec2& v) {
-    glUniform2f(uniformLocation(name), v.x, v.y);
+    TRACE_SCOPE("Shader::setVec2");
+    const std::pair<int, int>& u = uniformLocation(name);
+    set(Uniform<glm::vec2>(u.first, u.second), v);
 }
 
+bool Shader::bindUniformBlock(const char* name, unsigned int binding) {
+    unsigned int index = glGetUniformBlockIndex(m_id, name);
+    if (index == GL_INVALID_INDEX) return false;
+    glUniformBlockBinding(m_id, index, binding);
+    return true;
+}
+
+bool Shader::changed(int location, int slot, const void* value, size_t size) {
+    // -1 (not in the program) is a no-op for GL too
+    if (location < 0) {
+        GLState::countUniform(true);
+        return false;
+    }
+    // glUniform* writes to whatever program is bound; caching the value for
+    // this one would turn a wrong upload into a lasting one
+    assert(GLState::program() == m_id && "Shader::set() on a program that isn't in use");
+    if (slot < 0 || (size_t)slot >= m_values.size()) {
+        GLState::countUniform(false);
+        return true;
+    }
+
+    UniformValue& last = m_values[slot];
+    const bool elided = last.valid && std::memcmp(last.bytes, value, size) == 0;
+    GLState::countUniform(elided);
+    if (elided) return false;
+    std::memcpy(last.bytes, value, size);
+    last.valid = true;
+    return true;
+}
+
+void Shader::set(Uniform<int> u, int v) {
+    if (changed(u.location, u.slot, &v, sizeof(v))) glUniform1i(u.location, v);
+}
+
+void Shader::set(Uniform<float> u, float v) {
+    if (changed(u.location, u.slot, &v, sizeof(v))) glUniform1f(u.location, v);
+}
+
+void Shader::set(Uniform<glm::vec2> u, const glm::vec2& v) {
+    const float f[2] = { v.x, v.y };
+    if (changed(u.location, u.slot, f, sizeof(f))) glUniform2f(u.location, v.x, v.y);
+}
+
+void Shader::set(Uniform<glm::vec3> u, const glm::vec3& v) {
+    const float f[3] = { v.x, v.y, v.z };
+    if (changed(u.location, u.slot, f, sizeof(f))) glUniform3f(u.location, v.x, v.y, v.z);
+}
+
+void Shader::set(Uniform<glm::mat4> u, const glm::mat4& m) {
+    if (changed(u.location, u.slot, &m[0][0], sizeof(float) * 16)) glUniformMatrix4fv(u.location, 1, GL_FALSE, &m[0][0]);
+}
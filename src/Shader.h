@@ -1,12 +1,45 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
 
+// FNV-1a of a uniform name. UniformName hashes at run time like any call
+// (C++11 doesn't make it a constant for a literal argument), so uniform<T>()
+// is a hash plus a map lookup: resolve handles once, not per frame.
+constexpr uint32_t uniformHash(const char* s, uint32_t h = 2166136261u) {
+    return *s ? uniformHash(s + 1, (h ^ (uint32_t)(unsigned char)*s) * 16777619u) : h;
+}
+
+// A uniform name and its hash (implicit from a string)
+struct UniformName {
+    constexpr UniformName(const char* s) : str(s), hash(uniformHash(s)) {}
+    const char* str;
+    uint32_t hash;
+};
+
+// The location of a uniform in one program, typed by the value it takes.
+// Resolve once with Shader::uniform<T>(), then set() is a plain
+// glUniform* call: no string, no lookup (and none at all when the value is
+// what the program already has). `slot` indexes that program's copy of the
+// last value; -1 = not cached.
+template <typename T>
+struct Uniform {
+    explicit Uniform(int loc = -1, int s = -1) : location(loc), slot(s) {}
+    int location;
+    int slot;
+};
+
 class Shader {
 public:
     Shader() = default;
     Shader(const char* vertexSrc, const char* fragmentSrc);
+    // Takes ownership of an already linked program (see ShaderCache)
+    explicit Shader(unsigned int program) : m_id(program) {}
+    // Compute program (GL 4.3); empty (id() == 0) if it fails to build
+    static Shader compute(const char* computeSrc);
 
     ~Shader();
 
@@ -22,19 +55,52 @@ public:
 
     unsigned int id() const { return m_id; }
 
-    // Uniform helpers (cached)
+    // Uniform helpers (cached by name; every call hashes a std::string).
+    // These and set() upload to this program, which must be the one in use.
     void setInt(const std::string& name, int v);
     void setFloat(const std::string& name, float v);
     void setVec3(const std::string& name, const glm::vec3& v);
     void setMat4(const std::string& name, const glm::mat4& m);
     void setVec2(const std::string& name, const glm::vec2& v);
 
+    // Attaches the uniform block `name` to a buffer binding point; false if
+    // the program doesn't use the block
+    bool bindUniformBlock(const char* name, unsigned int binding);
+
+    // Typed handles (bools are Uniform<int>)
+    template <typename T>
+    Uniform<T> uniform(UniformName name) {
+        const int location = handleLocation(name);
+        return Uniform<T>(location, slot(location));
+    }
+
+    void set(Uniform<int> u, int v);
+    void set(Uniform<float> u, float v);
+    void set(Uniform<glm::vec2> u, const glm::vec2& v);
+    void set(Uniform<glm::vec3> u, const glm::vec3& v);
+    void set(Uniform<glm::mat4> u, const glm::mat4& m);
 
 private:
     unsigned int m_id = 0;
-    std::unordered_map<std::string, int> m_uniformCache;
+    // name -> (location, slot) for the string setters
+    std::unordered_map<std::string, std::pair<int, int> > m_uniformCache;
+    // uniformHash -> (name, location) for uniform<T>()
+    std::unordered_map<uint32_t, std::pair<std::string, int> > m_handleCache;
+
+    // Last value uploaded per slot, so unchanged sets are skipped. Every
+    // resolved location gets the next slot; locations themselves need not
+    // be small or dense.
+    struct UniformValue {
+        bool valid = false;
+        unsigned char bytes[sizeof(float) * 16];
+    };
+    std::unordered_map<int, int> m_slots; // location -> index into m_values
+    std::vector<UniformValue> m_values;
+    bool changed(int location, int slot, const void* value, size_t size);
 
     unsigned int compile(unsigned int type, const char* src);
-    int uniformLocation(const std::string& name);
+    const std::pair<int, int>& uniformLocation(const std::string& name);
+    int handleLocation(const UniformName& name);
+    int slot(int location);
     void destroy();
 };
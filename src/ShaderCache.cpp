@@ -0,0 +1,221 @@
+#include "ShaderCache.h"
+
+#include <glad/glad.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "CacheFile.h"
+#include "GLState.h"
+#include "Trace.h"
+
+namespace {
+
+// Bump when the file layout changes; old files are ignored
+const uint32_t kCacheVersion = 1;
+const char kMagic[4] = { 'O', 'P', 'S', 'B' };
+
+// On-disk layout (host byte order): FileHeader, then the binary. The common
+// header's hash is the sources-and-driver key, as in the file name.
+struct FileHeader {
+    CacheFileHeader common;
+    uint32_t format; // glProgramBinary binaryFormat
+    uint32_t length;
+};
+
+// Program binaries need GL 4.1 and at least one format
+bool binariesSupported()
+{
+#ifdef GL_VERSION_4_1
+    if (!GLAD_GL_VERSION_4_1) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+#else
+    return false;
+#endif
+}
+
+std::string glString(GLenum name)
+{
+    const char* s = (const char*)glGetString(name);
+    return s ? s : "";
+}
+
+GLuint compileShader(GLenum type, const char* src)
+{
+    GLuint sh = glCreateShader(type);
+    glShaderSource(sh, 1, &src, nullptr);
+    glCompileShader(sh);
+    return sh;
+}
+
+void printShaderLog(GLuint sh, const char* kind)
+{
+    GLint success = 0;
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &success);
+    if (success) return;
+    char info[1024];
+    glGetShaderInfoLog(sh, sizeof(info), nullptr, info);
+    std::cerr << kind << " shader compile error:\n" << info << "\n";
+}
+
+} // namespace
+
+void ShaderCache::init(const std::string& dir)
+{
+    m_dir = dir;
+    if (!m_dir.empty()) makeCacheDirectory(m_dir);
+}
+
+std::string ShaderCache::cachePath(uint64_t hash) const
+{
+    std::ostringstream path;
+    path << m_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return path.str();
+}
+
+bool ShaderCache::build(const ShaderSource* sources, Shader* const* programs, int count)
+{
+    TRACE_SCOPE("ShaderCache::build");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    m_stats = Stats();
+
+    const bool binaries = !m_dir.empty() && binariesSupported();
+    const std::string driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+    struct Pending {
+        uint64_t hash = 0;
+        GLuint program = 0;
+        GLuint vs = 0, fs = 0; // 0 = loaded from the cache
+    };
+    std::vector<Pending> pending(count);
+
+    // Hashes first: a miss is compiled right away, before any binary is
+    // read, so the driver has the most time to work on it
+    for (int i = 0; i < count; i++) {
+        Pending& p = pending[i];
+        if (binaries) {
+            std::string key = std::string(sources[i].vertex) + '\0' + sources[i].fragment + '\0' + driver;
+            p.hash = cacheHash(key.data(), key.size());
+            std::ifstream probe(cachePath(p.hash).c_str(), std::ios::binary);
+            if (probe) continue; // load below
+        }
+        p.vs = compileShader(GL_VERTEX_SHADER, sources[i].vertex);
+        p.fs = compileShader(GL_FRAGMENT_SHADER, sources[i].fragment);
+    }
+    // ...then every link, still without a status query
+    for (int i = 0; i < count; i++) {
+        Pending& p = pending[i];
+        if (p.vs == 0) continue;
+        p.program = glCreateProgram();
+        glAttachShader(p.program, p.vs);
+        glAttachShader(p.program, p.fs);
+#ifdef GL_VERSION_4_1
+        if (binaries) glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(p.program);
+    }
+
+    // Cached binaries; one the driver rejects is compiled after all
+    for (int i = 0; i < count; i++) {
+        Pending& p = pending[i];
+        if (p.vs != 0) continue;
+        p.program = glCreateProgram();
+        if (load(p.hash, p.program)) {
+            m_stats.hits++;
+            continue;
+        }
+        GLState::deleteProgram(p.program);
+        p.program = glCreateProgram();
+        p.vs = compileShader(GL_VERTEX_SHADER, sources[i].vertex);
+        p.fs = compileShader(GL_FRAGMENT_SHADER, sources[i].fragment);
+        glAttachShader(p.program, p.vs);
+        glAttachShader(p.program, p.fs);
+#ifdef GL_VERSION_4_1
+        glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(p.program);
+    }
+
+    // Only now wait for the compiles
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        Pending& p = pending[i];
+        if (p.vs != 0) {
+            m_stats.misses++;
+            GLint success = 0;
+            glGetProgramiv(p.program, GL_LINK_STATUS, &success);
+            if (!success) {
+                printShaderLog(p.vs, "Vertex");
+                printShaderLog(p.fs, "Fragment");
+                char info[1024];
+                glGetProgramInfoLog(p.program, sizeof(info), nullptr, info);
+                std::cerr << "Shader link error:\n" << info << "\n";
+                ok = false;
+            } else if (binaries && !save(p.hash, p.program)) {
+                std::cerr << "ShaderCache: cannot write " << cachePath(p.hash) << "\n";
+            }
+            glDeleteShader(p.vs);
+            glDeleteShader(p.fs);
+        }
+        *programs[i] = Shader(p.program);
+    }
+
+    m_stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+bool ShaderCache::load(uint64_t hash, unsigned int program) const
+{
+    TRACE_SCOPE("ShaderCache::load");
+#ifdef GL_VERSION_4_1
+    std::ifstream in(cachePath(hash).c_str(), std::ios::binary);
+    FileHeader header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+    if (!cacheHeaderMatches(header.common, kMagic, kCacheVersion, hash) || header.length == 0) {
+        return false;
+    }
+    std::vector<char> binary(header.length);
+    if (!in.read(binary.data(), (std::streamsize)binary.size())) return false;
+
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+#else
+    (void)hash;
+    (void)program;
+    return false;
+#endif
+}
+
+bool ShaderCache::save(uint64_t hash, unsigned int program) const
+{
+    TRACE_SCOPE("ShaderCache::save");
+#ifdef GL_VERSION_4_1
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    FileHeader header;
+    setCacheHeader(header.common, kMagic, kCacheVersion, hash);
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    const FileChunk chunks[] = {
+        { &header, sizeof(header) },
+        { binary.data(), binary.size() },
+    };
+    return writeCacheFile(cachePath(hash), chunks, 2);
+#else
+    (void)hash;
+    (void)program;
+    return false;
+#endif
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Shader.h"
+
+// Vertex and fragment source of one program
+struct ShaderSource {
+    const char* vertex;
+    const char* fragment;
+};
+
+// Builds a set of programs at once through an on-disk cache of linked
+// program binaries (glGetProgramBinary, GL 4.1).
+//
+// Each program is <hash>.bin in the cache directory, the hash covering both
+// sources and the GL vendor/renderer/version, so an edited shader or a
+// driver update is simply a miss. Misses are all compiled and linked before
+// the first status query, so the driver can work on them in parallel
+// (KHR_parallel_shader_compile, or its own compiler threads) while the
+// cached binaries load. Without binary support, or when the driver rejects a
+// binary, programs are compiled from source.
+class ShaderCache {
+public:
+    struct Stats {
+        int hits = 0;     // loaded from a binary
+        int misses = 0;   // compiled
+        double ms = 0.0;  // whole build()
+    };
+
+    // Empty dir = always compile. Creates the directory.
+    void init(const std::string& dir);
+
+    // Builds sources[i] into *programs[i]. False if any program failed to
+    // link (the errors are printed; the others are still usable).
+    bool build(const ShaderSource* sources, Shader* const* programs, int count);
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    std::string cachePath(uint64_t hash) const;
+    bool load(uint64_t hash, unsigned int program) const;
+    bool save(uint64_t hash, unsigned int program) const;
+
+    std::string m_dir;
+    Stats m_stats;
+};
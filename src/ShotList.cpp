@@ -0,0 +1,152 @@
+#include "ShotList.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+
+static std::string trim(const std::string& s)
+{
+    const char* ws = " \t\r\n";
+    size_t b = s.find_first_not_of(ws);
+    if (b == std::string::npos) return std::string();
+    size_t e = s.find_last_not_of(ws);
+    return s.substr(b, e - b + 1);
+}
+
+template <typename T>
+static bool readValue(std::istringstream& in, T& out)
+{
+    T v;
+    if (!(in >> v)) return false;
+    out = v;
+    return true;
+}
+
+static bool readBool(std::istringstream& in, bool& out)
+{
+    std::string v;
+    if (!(in >> v)) return false;
+    if (v == "1" || v == "true" || v == "on" || v == "yes")   { out = true;  return true; }
+    if (v == "0" || v == "false" || v == "off" || v == "no")  { out = false; return true; }
+    return false;
+}
+
+static bool readVec3(std::istringstream& in, glm::vec3& out)
+{
+    glm::vec3 v;
+    if (!(in >> v.x >> v.y >> v.z)) return false;
+    out = v;
+    return true;
+}
+
+// Returns false for unknown keys or unparsable values
+static bool setShotValue(Shot& shot, const std::string& key, std::istringstream& in)
+{
+    // camera
+    if (key == "position")          return readVec3(in, shot.position);
+    if (key == "yaw")               return readValue(in, shot.yaw);
+    if (key == "pitch")             return readValue(in, shot.pitch);
+    if (key == "fov")               return readValue(in, shot.fov);
+
+    // light
+    if (key == "light_snap")        return readBool(in, shot.lightSnapMode);
+    if (key == "light_steps")       return readValue(in, shot.lightSnapSteps) && shot.lightSnapSteps > 0;
+    if (key == "light_index")       return readValue(in, shot.lightSnapIndex);
+    if (key == "light_angle")       return readValue(in, shot.lightAngle);
+    if (key == "light_radius")      return readValue(in, shot.lightOrbitRadius);
+    if (key == "light_height")      return readValue(in, shot.lightHeight);
+
+    // post
+    if (key == "brightness")        return readValue(in, shot.brightness);
+    if (key == "contrast")          return readValue(in, shot.contrast);
+    if (key == "exposure")          return readValue(in, shot.exposure);
+    if (key == "saturation")        return readValue(in, shot.saturation);
+    if (key == "vignette")          return readValue(in, shot.vignette);
+    if (key == "vignette_softness") return readValue(in, shot.vignetteSoftness);
+    if (key == "bloom")             return readBool(in, shot.bloomEnabled);
+    if (key == "bloom_threshold")   return readValue(in, shot.bloomThreshold);
+    if (key == "bloom_strength")    return readValue(in, shot.bloomStrength);
+
+    return false;
+}
+
+bool loadShotList(const std::string& path, const Shot& defaults,
+                  std::vector<Shot>& shots, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    shots.clear();
+    std::set<std::string> names;
+    std::string line;
+    int lineNo = 0;
+
+    while (std::getline(file, line)) {
+        lineNo++;
+
+        size_t comment = line.find_first_of("#;");
+        if (comment != std::string::npos) line.erase(comment);
+        line = trim(line);
+        if (line.empty()) continue;
+
+        std::ostringstream where;
+        where << path << ":" << lineNo << ": ";
+
+        if (line[0] == '[') {
+            if (line[line.size() - 1] != ']') {
+                error = where.str() + "unterminated shot header";
+                return false;
+            }
+            Shot shot = shots.empty() ? defaults : shots.back();
+            shot.name = trim(line.substr(1, line.size() - 2));
+            if (shot.name.empty()) {
+                std::ostringstream name;
+                name << "shot_" << shots.size();
+                shot.name = name.str();
+            }
+            // the name becomes <output dir>/<name>.png: keep it a plain file
+            // name, and unique so no shot overwrites another
+            if (shot.name.find_first_of("/\\:") != std::string::npos) {
+                error = where.str() + "shot name '" + shot.name + "' may not contain / \\ or :";
+                return false;
+            }
+            if (!names.insert(shot.name).second) {
+                error = where.str() + "duplicate shot name '" + shot.name + "'";
+                return false;
+            }
+            shots.push_back(shot);
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            error = where.str() + "expected 'key = value'";
+            return false;
+        }
+        if (shots.empty()) {
+            error = where.str() + "setting before the first [shot] header";
+            return false;
+        }
+
+        std::string key = trim(line.substr(0, eq));
+        std::string value = line.substr(eq + 1);
+        // allow "1, 2, 3" as well as "1 2 3" for vectors
+        std::replace(value.begin(), value.end(), ',', ' ');
+
+        std::istringstream in(value);
+        if (!setShotValue(shots.back(), key, in)) {
+            error = where.str() + "bad value or unknown key '" + key + "'";
+            return false;
+        }
+    }
+
+    if (shots.empty()) {
+        error = path + ": no shots";
+        return false;
+    }
+    return true;
+}
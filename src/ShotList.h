@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Everything that defines one framed still: camera pose, light and grading.
+// Mirrors the globals processInput() edits interactively.
+struct Shot {
+    std::string name;
+
+    // camera
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+    float yaw   = -90.0f;
+    float pitch = 0.0f;
+    float fov   = 45.0f;
+
+    // light
+    bool  lightSnapMode    = true;
+    int   lightSnapSteps   = 8;
+    int   lightSnapIndex   = 0;
+    float lightAngle       = 0.0f; // degrees, used when snap mode is off
+    float lightOrbitRadius = 2.0f;
+    float lightHeight      = 2.0f;
+
+    // post
+    float brightness       = 0.0f;
+    float contrast         = 1.0f;
+    float exposure         = 0.0f;
+    float saturation       = 1.0f;
+    float vignette         = 0.0f;
+    float vignetteSoftness = 0.35f;
+    bool  bloomEnabled     = true;
+    float bloomThreshold   = 0.3f;
+    float bloomStrength    = 1.8f;
+};
+
+// Loads a shot list. The format is INI-like:
+//
+//   # comment
+//   [hill_morning]             <- starts a shot, the name is the output file name
+//   position = 0 1.5 6
+//   yaw = -90
+//   light_index = 3
+//   exposure = 0.4
+//
+//   [hill_noon]                <- starts from a copy of the previous shot,
+//   light_index = 5               so only what changes needs listing
+//
+// The first shot starts from `defaults`. Shot names must be unique and may
+// not contain path separators. Returns false and fills `error` (with the line
+// number) on a malformed file.
+bool loadShotList(const std::string& path, const Shot& defaults,
+                  std::vector<Shot>& shots, std::string& error);
@@ -0,0 +1,499 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Culling.h"
+#include "GLState.h"
+#include "Parallel.h"
+#include "Shader.h"
+#include "Trace.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TERRAIN_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+const float kHillAmp  = 0.35f;   // hill height
+const float kHillFreq = 0.35f;   // hill frequency
+}
+
+float Terrain::heightAt(float x, float z)
+{
+    return kHillAmp * std::sin(x * kHillFreq) * std::cos(z * kHillFreq);
+}
+
+float Terrain::maxHeight()
+{
+    return kHillAmp;
+}
+
+// heightAt() is separable, amp * sin(fx) * cos(fz), so a grid needs one sine
+// per column and one cosine per row; every height is then a single multiply.
+// The tables carry a one-vertex border so the central differences for the
+// normals reach past the grid edge: with e = step,
+//   n ~ (-(h[x+1] - h[x-1]), 2e, -(h[z+1] - h[z-1]))
+// which is what normalAt() computes with its own epsilon.
+void Terrain::generateGrid(float x0, float z0, float step, int row, float* out, int threads)
+{
+    std::vector<float> sx(row + 2), cz(row + 2);
+    for (int i = 0; i < row + 2; i++) {
+        sx[i] = kHillAmp * std::sin((x0 + (float)(i - 1) * step) * kHillFreq);
+        cz[i] = std::cos((z0 + (float)(i - 1) * step) * kHillFreq);
+    }
+    const float twoStep = 2.0f * step;
+
+    auto genRow = [&](int z) {
+        const float czm = cz[z], cz0 = cz[z + 1], czp = cz[z + 2];
+        const float dcz = czp - czm;
+        const float worldZ = z0 + (float)z * step;
+        float* v = out + (size_t)z * row * 6;
+
+        int x = 0;
+#ifdef TERRAIN_SSE
+        const __m128 vcz0 = _mm_set1_ps(cz0);
+        const __m128 vdcz = _mm_set1_ps(dcz);
+        const __m128 vny  = _mm_set1_ps(twoStep);
+        const __m128 vny2 = _mm_set1_ps(twoStep * twoStep);
+        const __m128 half = _mm_set1_ps(0.5f), three = _mm_set1_ps(3.0f);
+        const __m128 neg = _mm_set1_ps(-0.0f);
+        for (; x + 4 <= row; x += 4) {
+            __m128 sL = _mm_loadu_ps(&sx[x]);
+            __m128 s0 = _mm_loadu_ps(&sx[x + 1]);
+            __m128 sR = _mm_loadu_ps(&sx[x + 2]);
+
+            __m128 h  = _mm_mul_ps(s0, vcz0);
+            __m128 dx = _mm_mul_ps(_mm_sub_ps(sR, sL), vcz0); // h[x+1] - h[x-1]
+            __m128 dz = _mm_mul_ps(s0, vdcz);                 // h[z+1] - h[z-1]
+
+            // 1/|n| by rsqrt plus one Newton step (~22 bits)
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), vny2);
+            __m128 r = _mm_rsqrt_ps(len2);
+            r = _mm_mul_ps(_mm_mul_ps(half, r), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(len2, r), r)));
+
+            float hs[4], nx[4], ny[4], nz[4];
+            _mm_storeu_ps(hs, h);
+            _mm_storeu_ps(nx, _mm_mul_ps(_mm_xor_ps(dx, neg), r));
+            _mm_storeu_ps(ny, _mm_mul_ps(vny, r));
+            _mm_storeu_ps(nz, _mm_mul_ps(_mm_xor_ps(dz, neg), r));
+            for (int k = 0; k < 4; k++) {
+                float* o = v + (size_t)(x + k) * 6;
+                o[0] = x0 + (float)(x + k) * step;
+                o[1] = hs[k];
+                o[2] = worldZ;
+                o[3] = nx[k];
+                o[4] = ny[k];
+                o[5] = nz[k];
+            }
+        }
+#endif
+        for (; x < row; x++) {
+            float dx = (sx[x + 2] - sx[x]) * cz0;
+            float dz = sx[x + 1] * dcz;
+            float inv = 1.0f / std::sqrt(dx * dx + twoStep * twoStep + dz * dz);
+            float* o = v + (size_t)x * 6;
+            o[0] = x0 + (float)x * step;
+            o[1] = sx[x + 1] * cz0;
+            o[2] = worldZ;
+            o[3] = -dx * inv;
+            o[4] = twoStep * inv;
+            o[5] = -dz * inv;
+        }
+    };
+
+    if (threads == 1) {
+        for (int z = 0; z < row; z++) genRow(z);
+        return;
+    }
+    // blocks of rows, so each task is worth a thread handoff
+    const int rowsPerTask = 16;
+    parallelFor((row + rowsPerTask - 1) / rowsPerTask, [&](int t) {
+        const int end = std::min(row, (t + 1) * rowsPerTask);
+        for (int z = t * rowsPerTask; z < end; z++) genRow(z);
+    }, threads);
+}
+
+glm::vec3 Terrain::normalAt(float x, float z)
+{
+    const float eps = 0.05f;
+    float hL = heightAt(x - eps, z);
+    float hR = heightAt(x + eps, z);
+    float hD = heightAt(x, z - eps);
+    float hU = heightAt(x, z + eps);
+
+    // slope vectors
+    glm::vec3 dx(2.0f * eps, hR - hL, 0.0f);
+    glm::vec3 dz(0.0f, hU - hD, 2.0f * eps);
+
+    glm::vec3 n = glm::normalize(glm::cross(dz, dx));
+    return n;
+}
+
+void Terrain::init(const TerrainSettings& settings)
+{
+    destroy();
+    m_settings = settings;
+    m_settings.patchQuads = std::max(1, std::min(settings.patchQuads, 250)); // 16-bit indices
+
+    m_maxLevel = 0;
+    while (m_maxLevel < 20 && nodeSize(m_maxLevel + 1) >= m_settings.minChunkSize) m_maxLevel++;
+
+    // One index buffer for every chunk: the grid, then a skirt strip per edge
+    const int q = m_settings.patchQuads;
+    const int row = q + 1;
+    std::vector<unsigned short> idx;
+    idx.reserve((size_t)6 * q * q + (size_t)4 * 6 * q);
+
+    for (int z = 0; z < q; z++) {
+        for (int x = 0; x < q; x++) {
+            unsigned short i0 = (unsigned short)(z * row + x);
+            unsigned short i1 = (unsigned short)(i0 + 1);
+            unsigned short i2 = (unsigned short)(i0 + row);
+            unsigned short i3 = (unsigned short)(i2 + 1);
+
+            idx.push_back(i0); idx.push_back(i2); idx.push_back(i1);
+            idx.push_back(i1); idx.push_back(i2); idx.push_back(i3);
+        }
+    }
+
+    // Skirt vertices follow the grid: edge e, vertex k -> row*row + e*row + k
+    for (int e = 0; e < 4; e++) {
+        for (int k = 0; k < q; k++) {
+            unsigned short a0, a1;
+            switch (e) {
+            case 0:  a0 = (unsigned short)k;               a1 = (unsigned short)(k + 1);             break; // z = 0
+            case 1:  a0 = (unsigned short)(q * row + k);   a1 = (unsigned short)(q * row + k + 1);   break; // z = max
+            case 2:  a0 = (unsigned short)(k * row);       a1 = (unsigned short)((k + 1) * row);     break; // x = 0
+            default: a0 = (unsigned short)(k * row + q);   a1 = (unsigned short)((k + 1) * row + q); break; // x = max
+            }
+            unsigned short s0 = (unsigned short)(row * row + e * row + k);
+            unsigned short s1 = (unsigned short)(s0 + 1);
+
+            idx.push_back(a0); idx.push_back(s0); idx.push_back(a1);
+            idx.push_back(a1); idx.push_back(s0); idx.push_back(s1);
+        }
+    }
+    m_indexCount = (GLsizei)idx.size();
+
+    glGenBuffers(1, &m_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(unsigned short), idx.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    if (m_settings.gpuDisplacement) initGpuPath();
+}
+
+// Height texture plus the one flat patch every chunk is drawn with. The
+// texture is filled the same way as generateGrid(): one sine per column, one
+// cosine per row, texel centers at heightAt() sample points.
+void Terrain::initGpuPath()
+{
+    TRACE_SCOPE("Terrain::initGpuPath");
+    const int res = std::max(2, m_settings.heightmapResolution);
+    m_settings.heightmapResolution = res;
+    const float texel = m_settings.size / (float)res;
+    const float origin = -m_settings.size * 0.5f + 0.5f * texel;
+
+    std::vector<float> sx(res), cz(res);
+    for (int i = 0; i < res; i++) {
+        sx[i] = kHillAmp * std::sin((origin + (float)i * texel) * kHillFreq);
+        cz[i] = std::cos((origin + (float)i * texel) * kHillFreq);
+    }
+    std::vector<float> heights((size_t)res * res);
+    const int rowsPerTask = 64;
+    parallelFor((res + rowsPerTask - 1) / rowsPerTask, [&](int t) {
+        const int end = std::min(res, (t + 1) * rowsPerTask);
+        for (int z = t * rowsPerTask; z < end; z++) {
+            float* out = heights.data() + (size_t)z * res;
+            for (int x = 0; x < res; x++) out[x] = sx[x] * cz[z];
+        }
+    });
+
+    glGenTextures(1, &m_heightTex);
+    GLState::bindTexture(GL_TEXTURE_2D, m_heightTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, res, res, 0, GL_RED, GL_FLOAT, heights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+
+    // Patch vertices (u, skirt, v) in the same order as the index buffer:
+    // the grid, then one skirt row per edge with skirt = -1
+    const int q = m_settings.patchQuads;
+    const int row = q + 1;
+    std::vector<float> verts;
+    verts.reserve((size_t)(row * row + 4 * row) * 3);
+    for (int z = 0; z < row; z++) {
+        for (int x = 0; x < row; x++) {
+            verts.push_back((float)x / q);
+            verts.push_back(0.0f);
+            verts.push_back((float)z / q);
+        }
+    }
+    for (int e = 0; e < 4; e++) {
+        for (int k = 0; k < row; k++) {
+            float u, v;
+            switch (e) {
+            case 0:  u = (float)k / q; v = 0.0f;          break; // z = 0
+            case 1:  u = (float)k / q; v = 1.0f;          break; // z = max
+            case 2:  u = 0.0f;         v = (float)k / q;  break; // x = 0
+            default: u = 1.0f;         v = (float)k / q;  break; // x = max
+            }
+            verts.push_back(u);
+            verts.push_back(-1.0f);
+            verts.push_back(v);
+        }
+    }
+
+    glGenVertexArrays(1, &m_patchVAO);
+    glGenBuffers(1, &m_patchVBO);
+    GLState::bindVertexArray(m_patchVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_patchVBO);
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+    // location 0 only; the shader derives normals from the height texture
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    GLState::bindVertexArray(0);
+}
+
+void Terrain::updateHeights(int x, int z, int width, int height, const float* heights)
+{
+    if (!m_heightTex) return;
+    const int res = m_settings.heightmapResolution;
+    if (x < 0 || z < 0 || width <= 0 || height <= 0 || x + width > res || z + height > res) {
+        std::cerr << "Terrain::updateHeights: region outside the " << res << "x" << res << " height map" << std::endl;
+        return;
+    }
+    GLState::bindTexture(GL_TEXTURE_2D, m_heightTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, z, width, height, GL_RED, GL_FLOAT, heights);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Terrain::destroy()
+{
+    for (std::unordered_map<uint64_t, Chunk>::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it) {
+        glDeleteBuffers(1, &it->second.vbo);
+        GLState::deleteVertexArrays(1, &it->second.vao);
+    }
+    m_chunks.clear();
+    if (m_ebo) glDeleteBuffers(1, &m_ebo);
+    m_ebo = 0;
+    m_indexCount = 0;
+
+    if (m_heightTex) GLState::deleteTextures(1, &m_heightTex);
+    if (m_patchVBO) glDeleteBuffers(1, &m_patchVBO);
+    if (m_patchVAO) GLState::deleteVertexArrays(1, &m_patchVAO);
+    m_heightTex = m_patchVBO = m_patchVAO = 0;
+}
+
+glm::vec2 Terrain::nodeOrigin(const Node& n) const
+{
+    const float s = nodeSize(n.level);
+    return glm::vec2(-m_settings.size * 0.5f + (float)n.x * s, -m_settings.size * 0.5f + (float)n.z * s);
+}
+
+void Terrain::buildVertices(const Node& node, std::vector<HalfPackedVertex>& verts) const
+{
+    TRACE_SCOPE("Terrain::buildVertices");
+    const int q = m_settings.patchQuads;
+    const int row = q + 1;
+    const float step = nodeSize(node.level) / (float)q;
+    const glm::vec2 origin = nodeOrigin(node);
+    const float skirt = 2.0f * maxHeight();
+
+    std::vector<float> grid((size_t)row * row * 6);
+    generateGrid(origin.x, origin.y, step, row, grid.data());
+
+    // The grid, then 4 skirt rows (same edge order as the index buffer).
+    // Positions are relative to the chunk corner, taken from the grid index
+    // so chunk edges land on exactly the same values.
+    verts.resize((size_t)(row * row + 4 * row));
+    for (int z = 0; z < row; z++) {
+        for (int x = 0; x < row; x++) {
+            const float* g = &grid[((size_t)z * row + x) * 6];
+            HalfPackedVertex& v = verts[(size_t)z * row + x];
+            v.pos[0] = floatToHalf((float)x * step);
+            v.pos[1] = floatToHalf(g[1]);
+            v.pos[2] = floatToHalf((float)z * step);
+            v.pos[3] = 0;
+            v.normal = packNormal(glm::vec3(g[3], g[4], g[5]));
+        }
+    }
+
+    HalfPackedVertex* out = verts.data() + (size_t)row * row;
+    for (int e = 0; e < 4; e++) {
+        for (int k = 0; k < row; k++) {
+            int gridIndex;
+            switch (e) {
+            case 0:  gridIndex = k;               break; // z = 0
+            case 1:  gridIndex = q * row + k;     break; // z = max
+            case 2:  gridIndex = k * row;         break; // x = 0
+            default: gridIndex = k * row + q;     break; // x = max
+            }
+            *out = verts[gridIndex];
+            out->pos[1] = floatToHalf(grid[(size_t)gridIndex * 6 + 1] - skirt);
+            out++;
+        }
+    }
+}
+
+Terrain::Chunk Terrain::uploadChunk(const std::vector<HalfPackedVertex>& verts) const
+{
+    Chunk chunk;
+    glGenVertexArrays(1, &chunk.vao);
+    glGenBuffers(1, &chunk.vbo);
+
+    GLState::bindVertexArray(chunk.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(HalfPackedVertex), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    setVertexAttribs(VertexHalfPosPackedNormal);
+
+    GLState::bindVertexArray(0);
+    return chunk;
+}
+
+void Terrain::resolveUniforms(Shader& shader)
+{
+    m_uniforms.model = shader.uniform<glm::mat4>("uModel");
+    m_uniforms.terrainGpu = shader.uniform<int>("uTerrainGpu");
+    m_uniforms.patch = shader.uniform<glm::vec3>("uPatch");
+    m_uniforms.heightMapXform = shader.uniform<glm::vec3>("uHeightMapXform");
+    m_uniforms.skirtDepth = shader.uniform<float>("uSkirtDepth");
+}
+
+void Terrain::render(Shader& shader, const glm::vec3& eye, const Frustum& frustum)
+{
+    TRACE_SCOPE("Terrain::render");
+    m_frame++;
+    m_stats = Stats();
+
+    m_drawList.clear();
+    Node root = { 0, 0, 0 };
+    select(root, eye, frustum);
+
+    const Uniform<glm::mat4> modelUniform = m_uniforms.model;
+
+    if (m_heightTex) {
+        const Uniform<int> terrainGpu = m_uniforms.terrainGpu;
+        const Uniform<glm::vec3> patch = m_uniforms.patch;
+        shader.set(terrainGpu, 1);
+        shader.set(m_uniforms.heightMapXform,
+                   glm::vec3(-m_settings.size * 0.5f, -m_settings.size * 0.5f, m_settings.size));
+        shader.set(m_uniforms.skirtDepth, 2.0f * maxHeight());
+        GLState::activeTexture(GL_TEXTURE1);
+        GLState::bindTexture(GL_TEXTURE_2D, m_heightTex);
+        GLState::activeTexture(GL_TEXTURE0);
+
+        GLState::bindVertexArray(m_patchVAO);
+        for (size_t i = 0; i < m_drawList.size(); i++) {
+            const glm::vec2 origin = nodeOrigin(m_drawList[i]);
+            shader.set(patch, glm::vec3(origin.x, origin.y, nodeSize(m_drawList[i].level)));
+            glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_SHORT, 0);
+        }
+        m_stats.chunksDrawn = (int)m_drawList.size();
+
+        shader.set(terrainGpu, 0);
+        GLState::bindVertexArray(0);
+        return;
+    }
+
+    buildMissingChunks();
+
+    glm::mat4 model(1.0f);
+    for (size_t i = 0; i < m_drawList.size(); i++) {
+        Chunk& chunk = m_chunks[key(m_drawList[i])];
+        chunk.lastUsed = m_frame;
+        const glm::vec2 origin = nodeOrigin(m_drawList[i]);
+        model[3] = glm::vec4(origin.x, 0.0f, origin.y, 1.0f);
+        shader.set(modelUniform, model);
+        GLState::bindVertexArray(chunk.vao);
+        glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+    m_stats.chunksDrawn = (int)m_drawList.size();
+    shader.set(modelUniform, glm::mat4(1.0f));
+
+    evict();
+    m_stats.chunksCached = (int)m_chunks.size();
+    GLState::bindVertexArray(0);
+}
+
+void Terrain::select(const Node& node, const glm::vec3& eye, const Frustum& frustum)
+{
+    const float s = nodeSize(node.level);
+    const float half = s * 0.5f;
+    const glm::vec3 center(-m_settings.size * 0.5f + ((float)node.x + 0.5f) * s,
+                           0.0f,
+                           -m_settings.size * 0.5f + ((float)node.z + 0.5f) * s);
+    const float yExtent = 3.0f * maxHeight(); // hills plus skirts
+
+    if (frustum.classify(center, glm::vec3(half, yExtent, half)) == Frustum::Outside) {
+        m_stats.chunksCulled++;
+        return;
+    }
+
+    // Distance from the eye to the chunk's box
+    float dx = std::max(std::fabs(eye.x - center.x) - half, 0.0f);
+    float dz = std::max(std::fabs(eye.z - center.z) - half, 0.0f);
+    float dy = std::max(std::fabs(eye.y) - maxHeight(), 0.0f);
+    float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+    if (node.level < m_maxLevel && dist < m_settings.lodDistance * s) {
+        for (int c = 0; c < 4; c++) {
+            Node child = { node.level + 1, node.x * 2 + (c & 1), node.z * 2 + (c >> 1) };
+            select(child, eye, frustum);
+        }
+        return;
+    }
+    m_drawList.push_back(node);
+}
+
+// Vertices of chunks seen for the first time are generated on all cores;
+// only the GL uploads stay on this thread.
+void Terrain::buildMissingChunks()
+{
+    std::vector<Node> missing;
+    for (size_t i = 0; i < m_drawList.size(); i++) {
+        if (m_chunks.find(key(m_drawList[i])) == m_chunks.end()) missing.push_back(m_drawList[i]);
+    }
+    if (missing.empty()) return;
+
+    TRACE_SCOPE("Terrain::buildMissingChunks");
+    std::vector<std::vector<HalfPackedVertex> > verts(missing.size());
+    parallelFor((int)missing.size(), [&](int i) {
+        buildVertices(missing[i], verts[i]);
+    });
+
+    for (size_t i = 0; i < missing.size(); i++) {
+        m_chunks[key(missing[i])] = uploadChunk(verts[i]);
+    }
+    m_stats.chunksBuilt = (int)missing.size();
+}
+
+// Drops the least recently drawn chunks once the cache is over budget
+void Terrain::evict()
+{
+    if ((int)m_chunks.size() <= m_settings.maxCachedChunks) return;
+
+    std::vector<std::pair<uint64_t, uint64_t> > byAge; // (lastUsed, key)
+    for (std::unordered_map<uint64_t, Chunk>::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it) {
+        if (it->second.lastUsed != m_frame) byAge.push_back(std::make_pair(it->second.lastUsed, it->first));
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    size_t excess = m_chunks.size() - (size_t)m_settings.maxCachedChunks;
+    for (size_t i = 0; i < byAge.size() && i < excess; i++) {
+        Chunk& c = m_chunks[byAge[i].second];
+        glDeleteBuffers(1, &c.vbo);
+        GLState::deleteVertexArrays(1, &c.vao);
+        m_chunks.erase(byAge[i].second);
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Shader.h"
+#include "VertexFormat.h"
+
+class Frustum;
+
+struct TerrainSettings {
+    float size = 4096.0f;      // world extent, square around the origin
+    float minChunkSize = 8.0f; // size of the finest chunks (size / 2^k)
+    int   patchQuads = 32;     // quads along a chunk edge, the same at every LOD
+    float lodDistance = 2.0f;  // a chunk splits while the camera is closer than lodDistance * its size
+    int   maxCachedChunks = 1024;
+
+    // GPU path: heights live in an R32F texture covering the whole terrain and
+    // one flat patch mesh is displaced in the vertex shader for every chunk.
+    // No per-chunk meshes; 4 bytes per height sample instead of 12 per vertex.
+    bool  gpuDisplacement = false;
+    int   heightmapResolution = 4096; // texels per side (4096 = 1 per unit at the default size)
+};
+
+// Heightfield terrain as a quadtree of chunks (geomipmapping style).
+//
+// Every chunk is the same patchQuads x patchQuads grid, so a chunk twice as
+// big has half the detail. Chunks are picked each frame from the camera
+// position: near ones are split until they are small enough, far ones stay
+// coarse. Neighbours of different LOD don't share edge vertices; a skirt hung
+// from each chunk border hides the gaps. Chunk meshes are built on first use
+// and kept in an LRU cache; chunks missing in a frame are generated in
+// parallel. Chunk vertices are 12 bytes: half float positions relative to the
+// chunk corner (drawn with uModel = translation) and packed normals. With
+// gpuDisplacement the chunks instead share one flat patch that the lighting
+// shader displaces from a height texture (uTerrainGpu).
+class Terrain {
+public:
+    struct Stats {
+        int chunksDrawn = 0;
+        int chunksCulled = 0;
+        int chunksBuilt = 0; // this frame
+        int chunksCached = 0;
+    };
+
+    Terrain() = default;
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    void init(const TerrainSettings& settings);
+    void destroy();
+
+    // Looks up the uniforms render() sets; once per program, before the
+    // first render() with it
+    void resolveUniforms(Shader& shader);
+
+    // Draws the chunks selected for `eye` that intersect the frustum. The
+    // caller sets up the rest of the shader (uModel, textures etc.).
+    void render(Shader& shader, const glm::vec3& eye, const Frustum& frustum);
+
+    // GPU path only: replaces a block of height samples (row-major, `width`
+    // floats per row) starting at texel (x, z)
+    void updateHeights(int x, int z, int width, int height, const float* heights);
+
+    const Stats& stats() const { return m_stats; }
+
+    static float heightAt(float x, float z);
+    static glm::vec3 normalAt(float x, float z);
+    // Bounds of heightAt() (for chunk boxes)
+    static float maxHeight();
+
+    // Fills row x row vertices, pos(3) + normal(3), of the heightfield grid
+    // starting at (x0, z0) with the given spacing into `out` (row * row * 6
+    // floats). Heights match heightAt(); normals are central differences of
+    // the height grid. Rows are split across `threads` (0 = all cores).
+    static void generateGrid(float x0, float z0, float step, int row, float* out, int threads = 1);
+
+private:
+    struct Chunk {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    struct Node {
+        int level;   // 0 = root
+        int x, z;    // index among the nodes of that level
+    };
+
+    void select(const Node& node, const glm::vec3& eye, const Frustum& frustum);
+    void buildMissingChunks();
+    void buildVertices(const Node& node, std::vector<HalfPackedVertex>& verts) const;
+    Chunk uploadChunk(const std::vector<HalfPackedVertex>& verts) const;
+    void evict();
+    void initGpuPath();
+
+    float nodeSize(int level) const { return m_settings.size / (float)(1 << level); }
+    glm::vec2 nodeOrigin(const Node& n) const;
+    static uint64_t key(const Node& n) { return ((uint64_t)n.level << 48) | ((uint64_t)n.x << 24) | (uint64_t)n.z; }
+
+    TerrainSettings m_settings;
+    int m_maxLevel = 0;
+    GLuint m_ebo = 0;
+    GLsizei m_indexCount = 0;
+
+    std::unordered_map<uint64_t, Chunk> m_chunks;
+    std::vector<Node> m_drawList; // per-frame scratch
+    uint64_t m_frame = 0;
+    Stats m_stats;
+
+    // GPU path
+    GLuint m_heightTex = 0;
+    GLuint m_patchVAO = 0;
+    GLuint m_patchVBO = 0;
+
+    // From resolveUniforms()
+    struct Uniforms {
+        Uniform<glm::mat4> model;
+        Uniform<int> terrainGpu;
+        Uniform<glm::vec3> patch, heightMapXform;
+        Uniform<float> skirtDepth;
+    };
+    Uniforms m_uniforms;
+};
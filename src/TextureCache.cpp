@@ -0,0 +1,365 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "CacheFile.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <stb_image.h>
+
+namespace {
+
+// Bump when the file layout or the encoders change; old files are ignored
+const uint32_t kCacheVersion = 1;
+const char kMagic[4] = { 'O', 'P', 'T', 'X' };
+
+// On-disk layout (host byte order): FileHeader, FileLevel[levelCount], data.
+// FileLevel::offset is relative to the start of data. The common header's
+// hash is the source file's.
+struct FileHeader {
+    CacheFileHeader common;
+    uint32_t format;
+    uint32_t levelCount;
+};
+
+struct FileLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::streamsize size = in.tellg();
+    if (size < 0) return false;
+    bytes.resize((size_t)size);
+    in.seekg(0);
+    return size == 0 || (bool)in.read((char*)bytes.data(), size);
+}
+
+inline unsigned short to565(int r, int g, int b)
+{
+    return (unsigned short)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+inline void from565(unsigned short c, int* rgb)
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// 2x2 box filter of an RGBA8 image into (w/2, h/2), at least 1x1; odd
+// edges reuse the last row/column
+void halve(const unsigned char* s, int width, int height, unsigned char* d)
+{
+    const int dw = std::max(1, width / 2), dh = std::max(1, height / 2);
+    for (int y = 0; y < dh; y++) {
+        const int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < dw; x++) {
+            const int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const unsigned char* a = s + ((size_t)y0 * width + x0) * 4;
+            const unsigned char* b = s + ((size_t)y0 * width + x1) * 4;
+            const unsigned char* c = s + ((size_t)y1 * width + x0) * 4;
+            const unsigned char* e = s + ((size_t)y1 * width + x1) * 4;
+            unsigned char* o = d + ((size_t)y * dw + x) * 4;
+            for (int k = 0; k < 4; k++) o[k] = (unsigned char)((a[k] + b[k] + c[k] + e[k] + 2) / 4);
+        }
+    }
+}
+
+} // namespace
+
+void TextureCache::init(const std::string& dir, bool compress)
+{
+    m_dir = dir;
+    m_compress = compress;
+    if (!m_dir.empty()) makeCacheDirectory(m_dir);
+}
+
+std::string TextureCache::cachePath(uint64_t sourceHash, int size) const
+{
+    char name[80];
+    std::snprintf(name, sizeof(name), "%016llx_%d_%s.tex", (unsigned long long)sourceHash, size,
+                  m_compress ? "bc1" : "rgba8");
+    return m_dir + "/" + name;
+}
+
+bool TextureCache::get(const std::string& sourcePath, TextureImage& image, int size, int threads,
+                       bool forceBC1) const
+{
+    std::vector<unsigned char> source;
+    if (!readFile(sourcePath, source) || source.empty()) return false;
+
+    const uint64_t sourceHash = cacheHash(source.data(), source.size());
+    const std::string path = m_dir.empty() ? std::string() : cachePath(sourceHash, size);
+    // an RGBA8 file where BC1 is forced is rebuilt, e.g. one written by a
+    // plain get() of the same image
+    if (!path.empty() && read(path, sourceHash, image) &&
+        (size <= 0 || (image.levels[0].width == size && image.levels[0].height == size)) &&
+        !(m_compress && forceBC1 && image.format != TextureImage::BC1)) {
+        return true;
+    }
+
+    TRACE_SCOPE("TextureCache::build");
+    int w, h, n;
+    unsigned char* rgba = stbi_load_from_memory(source.data(), (int)source.size(), &w, &h, &n, 4);
+    if (!rgba) return false;
+
+    bool opaque = true;
+    for (size_t i = 3; i < (size_t)w * h * 4 && opaque; i += 4) opaque = (rgba[i] == 255);
+    if (size > 0 && (w != size || h != size)) {
+        std::vector<unsigned char> resized;
+        resample(rgba, w, h, size, size, resized);
+        buildMips(resized.data(), size, size, image);
+    } else {
+        buildMips(rgba, w, h, image);
+    }
+    stbi_image_free(rgba);
+
+    if (m_compress && (opaque || forceBC1)) encodeBC1(image, threads);
+    if (!path.empty() && !write(path, sourceHash, image)) {
+        std::cerr << "TextureCache: cannot write " << path << "\n";
+    }
+    return true;
+}
+
+bool TextureCache::read(const std::string& path, uint64_t sourceHash, TextureImage& image) const
+{
+    TRACE_SCOPE("TextureCache::read");
+    std::vector<unsigned char> bytes;
+    if (!readFile(path, bytes) || bytes.size() < sizeof(FileHeader)) return false;
+
+    FileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (!cacheHeaderMatches(header.common, kMagic, kCacheVersion, sourceHash) ||
+        header.format > TextureImage::BC1 || header.levelCount == 0 || header.levelCount > 32) {
+        return false;
+    }
+
+    const size_t dataStart = sizeof(FileHeader) + header.levelCount * sizeof(FileLevel);
+    if (bytes.size() < dataStart) return false;
+
+    image.format = (TextureImage::Format)header.format;
+    image.levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        FileLevel fl;
+        std::memcpy(&fl, bytes.data() + sizeof(FileHeader) + i * sizeof(FileLevel), sizeof(fl));
+        if (fl.offset > bytes.size() - dataStart || fl.size > bytes.size() - dataStart - fl.offset) return false;
+
+        TextureImage::Level& level = image.levels[i];
+        level.width = (int)fl.width;
+        level.height = (int)fl.height;
+        level.offset = dataStart + (size_t)fl.offset; // the header stays in front, no copy
+        level.size = (size_t)fl.size;
+    }
+    image.data.swap(bytes);
+    return true;
+}
+
+bool TextureCache::write(const std::string& path, uint64_t sourceHash, const TextureImage& image) const
+{
+    TRACE_SCOPE("TextureCache::write");
+    FileHeader header;
+    setCacheHeader(header.common, kMagic, kCacheVersion, sourceHash);
+    header.format = (uint32_t)image.format;
+    header.levelCount = (uint32_t)image.levels.size();
+
+    std::vector<FileLevel> levels(image.levels.size());
+    for (size_t i = 0; i < image.levels.size(); i++) {
+        const TextureImage::Level& level = image.levels[i];
+        FileLevel fl = { (uint32_t)level.width, (uint32_t)level.height,
+                         (uint64_t)level.offset, (uint64_t)level.size };
+        levels[i] = fl;
+    }
+
+    const FileChunk chunks[] = {
+        { &header, sizeof(header) },
+        { levels.data(), levels.size() * sizeof(FileLevel) },
+        { image.data.data(), image.data.size() },
+    };
+    return writeCacheFile(path, chunks, 3);
+}
+
+void TextureCache::resample(const unsigned char* rgba, int width, int height,
+                            int newWidth, int newHeight, std::vector<unsigned char>& out)
+{
+    TRACE_SCOPE("TextureCache::resample");
+    out.resize((size_t)newWidth * newHeight * 4);
+    // Shrinking by more than 2x first halves with the box filter, so
+    // bilinear taps never skip source texels
+    std::vector<unsigned char> halved[2];
+    for (int i = 0; width >= 2 * newWidth && height >= 2 * newHeight; i ^= 1) {
+        halved[i].resize((size_t)(width / 2) * (height / 2) * 4);
+        halve(rgba, width, height, halved[i].data());
+        rgba = halved[i].data();
+        width /= 2;
+        height /= 2;
+    }
+
+    const float sx = (float)width / newWidth, sy = (float)height / newHeight;
+    for (int y = 0; y < newHeight; y++) {
+        const float fy = std::max(0.0f, ((float)y + 0.5f) * sy - 0.5f);
+        const int y0 = std::min((int)fy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        const float ty = fy - (float)y0;
+        for (int x = 0; x < newWidth; x++) {
+            const float fx = std::max(0.0f, ((float)x + 0.5f) * sx - 0.5f);
+            const int x0 = std::min((int)fx, width - 1), x1 = std::min(x0 + 1, width - 1);
+            const float tx = fx - (float)x0;
+            const unsigned char* a = rgba + ((size_t)y0 * width + x0) * 4;
+            const unsigned char* b = rgba + ((size_t)y0 * width + x1) * 4;
+            const unsigned char* c = rgba + ((size_t)y1 * width + x0) * 4;
+            const unsigned char* d = rgba + ((size_t)y1 * width + x1) * 4;
+            unsigned char* o = &out[((size_t)y * newWidth + x) * 4];
+            for (int k = 0; k < 4; k++) {
+                const float top = a[k] + (b[k] - a[k]) * tx;
+                const float bottom = c[k] + (d[k] - c[k]) * tx;
+                o[k] = (unsigned char)(top + (bottom - top) * ty + 0.5f);
+            }
+        }
+    }
+}
+
+void TextureCache::buildMips(const unsigned char* rgba, int width, int height, TextureImage& image)
+{
+    TRACE_SCOPE("TextureCache::buildMips");
+    image.format = TextureImage::RGBA8;
+    image.levels.clear();
+
+    size_t total = 0;
+    for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+        TextureImage::Level level;
+        level.width = w;
+        level.height = h;
+        level.offset = total;
+        level.size = (size_t)w * h * 4;
+        total += level.size;
+        image.levels.push_back(level);
+        if (w == 1 && h == 1) break;
+    }
+
+    image.data.resize(total);
+    std::memcpy(image.data.data(), rgba, image.levels[0].size);
+
+    for (size_t l = 1; l < image.levels.size(); l++) {
+        const TextureImage::Level& src = image.levels[l - 1];
+        halve(image.data.data() + src.offset, src.width, src.height, image.data.data() + image.levels[l].offset);
+    }
+}
+
+void TextureCache::encodeBC1(TextureImage& image, int threads)
+{
+    if (image.format != TextureImage::RGBA8) return;
+    TRACE_SCOPE("TextureCache::encodeBC1");
+
+    TextureImage out;
+    out.format = TextureImage::BC1;
+    size_t total = 0;
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        TextureImage::Level level = image.levels[l];
+        level.offset = total;
+        level.size = (size_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * 8;
+        total += level.size;
+        out.levels.push_back(level);
+    }
+    out.data.resize(total);
+
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        const TextureImage::Level& src = image.levels[l];
+        const unsigned char* s = image.data.data() + src.offset;
+        unsigned char* d = out.data.data() + out.levels[l].offset;
+        const int bw = (src.width + 3) / 4, bh = (src.height + 3) / 4;
+
+        // one task per row of blocks
+        parallelFor(bh, [&](int by) {
+            unsigned char block[64];
+            for (int bx = 0; bx < bw; bx++) {
+                for (int i = 0; i < 16; i++) {
+                    // blocks over the edge repeat the last texel
+                    const int x = std::min(bx * 4 + (i & 3), src.width - 1);
+                    const int y = std::min(by * 4 + (i >> 2), src.height - 1);
+                    std::memcpy(block + i * 4, s + ((size_t)y * src.width + x) * 4, 4);
+                }
+                encodeBC1Block(block, d + ((size_t)by * bw + bx) * 8);
+            }
+        }, bh >= 16 ? threads : 1);
+    }
+    image.format = out.format;
+    image.levels.swap(out.levels);
+    image.data.swap(out.data);
+}
+
+// Endpoints from the color bounding box, its diagonal flipped to follow the
+// red/green and blue/green correlation and inset by 1/16 so the extremes
+// land on the interpolated colors; each texel takes the closest of the four.
+void TextureCache::encodeBC1Block(const unsigned char* rgba, unsigned char* out)
+{
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 3; k++) {
+            const int v = rgba[i * 4 + k];
+            lo[k] = std::min(lo[k], v);
+            hi[k] = std::max(hi[k], v);
+            mean[k] += v;
+        }
+    }
+    for (int k = 0; k < 3; k++) mean[k] = (mean[k] + 8) / 16;
+
+    int covRG = 0, covBG = 0;
+    for (int i = 0; i < 16; i++) {
+        const int g = rgba[i * 4 + 1] - mean[1];
+        covRG += (rgba[i * 4 + 0] - mean[0]) * g;
+        covBG += (rgba[i * 4 + 2] - mean[2]) * g;
+    }
+    if (covRG < 0) std::swap(lo[0], hi[0]);
+    if (covBG < 0) std::swap(lo[2], hi[2]);
+
+    for (int k = 0; k < 3; k++) {
+        const int inset = (hi[k] - lo[k]) / 16;
+        hi[k] -= inset;
+        lo[k] += inset;
+    }
+
+    unsigned short c0 = to565(hi[0], hi[1], hi[2]);
+    unsigned short c1 = to565(lo[0], lo[1], lo[2]);
+    if (c0 < c1) std::swap(c0, c1); // c0 > c1 selects the 4-color mode
+
+    int palette[4][3];
+    from565(c0, palette[0]);
+    from565(c1, palette[1]);
+    for (int k = 0; k < 3; k++) {
+        palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+        palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                const int dr = rgba[i * 4 + 0] - palette[p][0];
+                const int dg = rgba[i * 4 + 1] - palette[p][1];
+                const int db = rgba[i * 4 + 2] - palette[p][2];
+                const int dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = (unsigned char)(c0 & 0xFF);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int b = 0; b < 4; b++) out[4 + b] = (unsigned char)(indices >> (8 * b));
+}
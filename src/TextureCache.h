@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A texture ready for glTexImage2D / glCompressedTexImage2D: every mip level,
+// RGBA8 or BC1 (DXT1), bottom row first like the rest of the GL uploads.
+struct TextureImage {
+    enum Format { RGBA8, BC1 };
+
+    struct Level {
+        int width = 0;
+        int height = 0;
+        size_t offset = 0; // into data
+        size_t size = 0;
+    };
+
+    Format format = RGBA8;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+};
+
+// On-disk cache of decoded textures.
+//
+// get() hashes the source file and looks for <hash>_<size>_<format>.tex in
+// the cache directory: a small header, the level table and all levels back
+// to back, read with a single read. On a miss the file is decoded with
+// stb_image, its mip chain is built on the CPU (and BC1 encoded across cores
+// when compression is on) and the result is written back for the next
+// launch. Opaque images only are compressed unless the caller forces BC1;
+// other images with alpha stay RGBA8.
+class TextureCache {
+public:
+    // Empty dir = no cache, every get() decodes. Creates the directory.
+    void init(const std::string& dir, bool compress);
+
+    bool compress() const { return m_compress; }
+
+    // Safe to call from several threads at once. size > 0 resamples the
+    // image to size x size first (texture array layers must all match).
+    // threads: for BC1 encoding, as in encodeBC1(); callers that already run
+    // in parallel pass 1. forceBC1: with compression on, encode images with
+    // alpha too (texture array layers must all share one format).
+    bool get(const std::string& sourcePath, TextureImage& image, int size = 0, int threads = 0,
+             bool forceBC1 = false) const;
+
+    // Bilinear resample of an RGBA8 image
+    static void resample(const unsigned char* rgba, int width, int height,
+                         int newWidth, int newHeight, std::vector<unsigned char>& out);
+    // Mip chain of an RGBA8 image (2x2 box filter down to 1x1)
+    static void buildMips(const unsigned char* rgba, int width, int height, TextureImage& image);
+    // Re-encodes every level of an RGBA8 image as BC1, blocks split over `threads` (0 = all cores)
+    static void encodeBC1(TextureImage& image, int threads = 0);
+    // One 4x4 block: 16 RGBA texels in, 8 bytes out
+    static void encodeBC1Block(const unsigned char* rgba, unsigned char* out);
+
+private:
+    std::string cachePath(uint64_t sourceHash, int size) const;
+    bool read(const std::string& path, uint64_t sourceHash, TextureImage& image) const;
+    bool write(const std::string& path, uint64_t sourceHash, const TextureImage& image) const;
+
+    std::string m_dir;
+    bool m_compress = false;
+};
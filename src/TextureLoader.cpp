@@ -0,0 +1,315 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include "GLState.h"
+#include "Parallel.h"
+#include "Trace.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace {
+
+int mipCount(int size)
+{
+    int levels = 1;
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+bool hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (ext && std::strcmp(ext, name) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+TextureLoader::~TextureLoader()
+{
+    destroy();
+}
+
+void TextureLoader::init(int threads, const std::string& cacheDir, bool compress)
+{
+    destroy();
+
+    if (threads <= 0) threads = std::max(1, defaultThreadCount() - 1);
+    // Same orientation for every image; set once, before any worker runs
+    stbi_set_flip_vertically_on_load(true);
+
+    if (compress && !hasExtension("GL_EXT_texture_compression_s3tc")) {
+        std::cerr << "TextureLoader: no S3TC support, textures stay uncompressed\n";
+        compress = false;
+    }
+    m_cache.init(cacheDir, compress);
+
+    glGenBuffers(1, &m_pbo);
+    m_stop = false;
+    for (int t = 0; t < threads; t++) m_workers.push_back(std::thread(&TextureLoader::workerLoop, this));
+}
+
+void TextureLoader::destroy()
+{
+    if (m_workers.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queued.clear();
+    }
+    m_jobReady.notify_all();
+    for (size_t t = 0; t < m_workers.size(); t++) m_workers[t].join();
+    m_workers.clear();
+
+    m_decoded.clear();
+    m_arraySizes.clear();
+
+    if (m_pbo) glDeleteBuffers(1, &m_pbo);
+    m_pbo = 0;
+}
+
+GLuint TextureLoader::load(const std::string& path, const glm::vec3& placeholder)
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    GLState::bindTexture(GL_TEXTURE_2D, tex);
+
+    // wrapping + filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // 1x1 is a complete mip chain on its own
+    const unsigned char texel[4] = {
+        (unsigned char)(glm::clamp(placeholder.x, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (unsigned char)(glm::clamp(placeholder.y, 0.0f, 1.0f) * 255.0f + 0.5f),
+        (unsigned char)(glm::clamp(placeholder.z, 0.0f, 1.0f) * 255.0f + 0.5f),
+        255
+    };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+
+    Job job;
+    job.path = path;
+    job.texture = tex;
+    queue(job);
+    return tex;
+}
+
+GLuint TextureLoader::createArray(int layerSize, int layers)
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, tex);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    const int levels = mipCount(layerSize);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    for (int l = 0, s = layerSize; l < levels; l++, s = std::max(1, s / 2)) {
+        if (m_cache.compress()) {
+            const GLsizei bytes = ((s + 3) / 4) * ((s + 3) / 4) * 8 * layers;
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, s, s, layers, 0, bytes, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, s, s, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    m_arraySizes[tex] = layerSize;
+    return tex;
+}
+
+void TextureLoader::loadLayer(GLuint array, int layer, const std::string& path, const glm::vec3& placeholder)
+{
+    std::unordered_map<GLuint, int>::const_iterator it = m_arraySizes.find(array);
+    if (it == m_arraySizes.end()) {
+        std::cerr << "TextureLoader: " << array << " is not a createArray() texture\n";
+        return;
+    }
+    const int layerSize = it->second;
+
+    // Placeholder: every level of the layer one flat color
+    unsigned char texels[64];
+    for (int i = 0; i < 16; i++) {
+        texels[i * 4 + 0] = (unsigned char)(glm::clamp(placeholder.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+        texels[i * 4 + 1] = (unsigned char)(glm::clamp(placeholder.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+        texels[i * 4 + 2] = (unsigned char)(glm::clamp(placeholder.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+        texels[i * 4 + 3] = 255;
+    }
+    unsigned char block[8];
+    TextureCache::encodeBC1Block(texels, block);
+
+    std::vector<unsigned char> fill;
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, array);
+    for (int l = 0, s = layerSize; l < mipCount(layerSize); l++, s = std::max(1, s / 2)) {
+        if (m_cache.compress()) {
+            const size_t blocks = (size_t)((s + 3) / 4) * ((s + 3) / 4);
+            fill.resize(blocks * 8);
+            for (size_t b = 0; b < blocks; b++) std::memcpy(&fill[b * 8], block, 8);
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, s, s, 1,
+                                      GL_COMPRESSED_RGB_S3TC_DXT1_EXT, (GLsizei)fill.size(), fill.data());
+        } else {
+            fill.resize((size_t)s * s * 4);
+            for (size_t t = 0; t < (size_t)s * s; t++) std::memcpy(&fill[t * 4], texels, 4);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, s, s, 1, GL_RGBA, GL_UNSIGNED_BYTE, fill.data());
+        }
+    }
+
+    Job job;
+    job.path = path;
+    job.texture = array;
+    job.layer = layer;
+    job.size = layerSize;
+    queue(job);
+}
+
+void TextureLoader::queue(Job& job)
+{
+    if (m_workers.empty()) {
+        std::cerr << "TextureLoader: not initialized, " << job.path << " keeps its placeholder\n";
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queued.push_back(std::move(job));
+    }
+    m_jobReady.notify_one();
+}
+
+void TextureLoader::poll(int maxUploads)
+{
+    for (int n = 0; maxUploads <= 0 || n < maxUploads; n++) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_decoded.empty()) return;
+            job = std::move(m_decoded.front());
+            m_decoded.pop_front();
+        }
+        upload(job);
+    }
+}
+
+void TextureLoader::flush()
+{
+    TRACE_SCOPE("TextureLoader::flush");
+    for (;;) {
+        poll(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_queued.empty() && m_decoding == 0 && m_decoded.empty()) return;
+        while (m_decoded.empty() && (m_decoding > 0 || !m_queued.empty())) m_jobDone.wait(lock);
+    }
+}
+
+int TextureLoader::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (int)(m_queued.size() + m_decoded.size()) + m_decoding;
+}
+
+void TextureLoader::workerLoop()
+{
+    Trace::setThreadName("texture decoder");
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_queued.empty() && !m_stop) m_jobReady.wait(lock);
+            if (m_stop) return;
+            job = std::move(m_queued.front());
+            m_queued.pop_front();
+            m_decoding++;
+        }
+
+        {
+            TRACE_SCOPE("TextureLoader::decode");
+            // One thread each: the decoders already run in parallel, and
+            // encoding on all cores from every decoder would start N^2 threads
+            // array layers must match the array's format, alpha or not
+            job.loaded = m_cache.get(job.path, job.image, job.size, 1, job.layer >= 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decoding--;
+            m_decoded.push_back(std::move(job));
+        }
+        m_jobDone.notify_all();
+    }
+}
+
+void TextureLoader::upload(Job& job)
+{
+    TRACE_SCOPE("TextureLoader::upload");
+    const TextureImage& image = job.image;
+    if (!job.loaded || image.levels.empty()) {
+        std::cout << "Failed to load texture: " << job.path << "\n";
+        return;
+    }
+
+    // All levels go into one freshly orphaned unpack buffer; the
+    // glTexImage2D calls then source from it and return without waiting
+    // for the transfer
+    const size_t bytes = image.data.size();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst) {
+        std::memcpy(dst, image.data.data(), bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (job.layer >= 0) {
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, job.texture);
+        for (size_t l = 0; l < image.levels.size(); l++) {
+            const TextureImage::Level& level = image.levels[l];
+            const void* pixels = dst ? (const void*)level.offset : (const void*)(image.data.data() + level.offset);
+            if (image.format == TextureImage::BC1) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)l, 0, 0, job.layer, level.width, level.height, 1,
+                                          GL_COMPRESSED_RGB_S3TC_DXT1_EXT, (GLsizei)level.size, pixels);
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)l, 0, 0, job.layer, level.width, level.height, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        job.image = TextureImage();
+        return;
+    }
+
+    GLState::bindTexture(GL_TEXTURE_2D, job.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    for (size_t l = 0; l < image.levels.size(); l++) {
+        const TextureImage::Level& level = image.levels[l];
+        // offset into the bound unpack buffer, or client memory if mapping failed
+        const void* pixels = dst ? (const void*)level.offset : (const void*)(image.data.data() + level.offset);
+        if (image.format == TextureImage::BC1) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)l, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, level.width, level.height,
+                                   0, (GLsizei)level.size, pixels);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)l, GL_RGBA8, level.width, level.height, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    job.image = TextureImage();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "TextureCache.h"
+
+// Non-blocking texture loading.
+//
+// load() returns a texture name right away, filled with a 1x1 placeholder
+// color, and queues the file for a pool of decoder threads. The decoders go
+// through a TextureCache, so after the first launch a texture is one file
+// read with its mip chain (and optionally BC1) already built. poll() (once
+// per frame, GL thread) uploads finished images through a pixel-unpack
+// buffer, so startup and the first frames never wait on JPG decoding. The
+// texture names don't change when the real image arrives.
+class TextureLoader {
+public:
+    TextureLoader() = default;
+    ~TextureLoader();
+
+    // Non-copyable (owns GL buffers and threads)
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Needs a current GL context. threads = 0: all cores but this one.
+    // cacheDir empty = decode every launch; compress = BC1 where the GL
+    // supports S3TC.
+    void init(int threads = 0, const std::string& cacheDir = std::string(), bool compress = false);
+    // Drops whatever is still queued, then releases the buffer and the
+    // workers. Textures belong to the caller and are not deleted.
+    void destroy();
+
+    // Repeat-wrapped, mipmapped 2D texture; `placeholder` is shown until the
+    // image is uploaded (and stays if the file can't be decoded)
+    GLuint load(const std::string& path, const glm::vec3& placeholder);
+
+    // Repeat-wrapped 2D texture array of `layers` square layers with full mip
+    // chains, RGBA8 or BC1 (when compressing). Layers stay undefined until
+    // loadLayer().
+    GLuint createArray(int layerSize, int layers);
+    // Fills one layer of a createArray() texture: the placeholder right away,
+    // the image (resampled to the layer size) once decoded
+    void loadLayer(GLuint array, int layer, const std::string& path, const glm::vec3& placeholder);
+
+    // Uploads at most maxUploads decoded images (0 = all that are ready).
+    // Never waits on the decoders.
+    void poll(int maxUploads = 1);
+
+    // Blocks until every loaded texture has its image
+    void flush();
+
+    // Number of textures still showing their placeholder for lack of data
+    int pending() const;
+
+private:
+    struct Job {
+        std::string path;
+        GLuint texture = 0;
+        int layer = -1;   // >= 0: array layer
+        int size = 0;     // array layer size
+        bool loaded = false;
+        TextureImage image;
+    };
+
+    void workerLoop();
+    void upload(Job& job);
+    void queue(Job& job);
+
+    std::vector<std::thread> m_workers;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_jobDone;
+    std::deque<Job> m_queued;
+    std::deque<Job> m_decoded;
+    int m_decoding = 0;
+    bool m_stop = false;
+
+    TextureCache m_cache;
+    GLuint m_pbo = 0;
+    std::unordered_map<GLuint, int> m_arraySizes; // createArray() texture -> layer size
+};
@@ -0,0 +1,175 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::s_enabled(false);
+std::atomic<uint64_t> Trace::s_sessionStart(0);
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Single producer (the owning thread), read by whoever dumps the trace.
+// The writer publishes with a release store of `head`; the reader discards
+// anything that may have been overwritten while it was copying.
+struct ThreadRing {
+    static const size_t kCapacity = 1 << 16;
+
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head;
+    int tid;
+    std::string name;
+
+    explicit ThreadRing(int id) : events(kCapacity), head(0), tid(id) {}
+};
+
+std::mutex gRegistryMutex;
+std::vector<std::unique_ptr<ThreadRing> > gRegistry; // rings outlive their threads
+
+ThreadRing& threadRing()
+{
+    thread_local ThreadRing* ring = nullptr;
+    if (!ring) {
+        std::lock_guard<std::mutex> lock(gRegistryMutex);
+        gRegistry.push_back(std::unique_ptr<ThreadRing>(new ThreadRing((int)gRegistry.size() + 1)));
+        ring = gRegistry.back().get();
+    }
+    return *ring;
+}
+
+void writeJsonString(std::ostream& os, const std::string& s)
+{
+    os << '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c == '"' || c == '\\') os << '\\' << c;
+        else if ((unsigned char)c < 0x20) os << ' ';
+        else os << c;
+    }
+    os << '"';
+}
+
+} // namespace
+
+uint64_t Trace::nowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+}
+
+void Trace::setEnabled(bool enabled)
+{
+    // Rings are never cleared (other threads own them); events from earlier
+    // sessions are filtered out by start time on export instead
+    if (enabled && !s_enabled.load(std::memory_order_relaxed)) {
+        s_sessionStart.store(nowNs(), std::memory_order_relaxed);
+    }
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadRing& ring = threadRing();
+    uint64_t h = ring.head.load(std::memory_order_relaxed);
+    TraceEvent& e = ring.events[h % ThreadRing::kCapacity];
+    e.name = name;
+    e.start = startNs;
+    e.end = endNs;
+    ring.head.store(h + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char* name)
+{
+    ThreadRing& ring = threadRing();
+    std::lock_guard<std::mutex> lock(gRegistryMutex); // a dump may be copying it
+    ring.name = name;
+}
+
+bool Trace::writeChromeJson(const std::string& path)
+{
+    struct Copy {
+        int tid;
+        std::string name;
+        std::vector<TraceEvent> events;
+    };
+    std::vector<Copy> copies;
+    const uint64_t sessionStart = s_sessionStart.load(std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(gRegistryMutex);
+        for (size_t r = 0; r < gRegistry.size(); r++) {
+            ThreadRing& ring = *gRegistry[r];
+            Copy c;
+            c.tid = ring.tid;
+            c.name = ring.name;
+
+            uint64_t headBefore = ring.head.load(std::memory_order_acquire);
+            uint64_t first = headBefore > ThreadRing::kCapacity ? headBefore - ThreadRing::kCapacity : 0;
+            for (uint64_t i = first; i < headBefore; i++) {
+                c.events.push_back(ring.events[i % ThreadRing::kCapacity]);
+            }
+
+            // Drop the oldest entries the owner may have overwritten meanwhile,
+            // plus slot headAfter % kCapacity, which it may be writing right now
+            // (head is only published after the write)
+            uint64_t headAfter = ring.head.load(std::memory_order_acquire);
+            uint64_t safeFirst = headAfter + 1 > ThreadRing::kCapacity ? headAfter + 1 - ThreadRing::kCapacity : 0;
+            if (safeFirst > first) {
+                size_t drop = (size_t)std::min<uint64_t>(safeFirst - first, c.events.size());
+                c.events.erase(c.events.begin(), c.events.begin() + drop);
+            }
+
+            // Only this session: earlier recordings are still in the ring
+            c.events.erase(std::remove_if(c.events.begin(), c.events.end(),
+                                          [sessionStart](const TraceEvent& e) { return e.start < sessionStart; }),
+                           c.events.end());
+            copies.push_back(c);
+        }
+    }
+
+    uint64_t origin = ~0ull;
+    for (size_t r = 0; r < copies.size(); r++) {
+        for (size_t i = 0; i < copies[r].events.size(); i++) {
+            if (copies[r].events[i].start < origin) origin = copies[r].events[i].start;
+        }
+    }
+
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) return false;
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (size_t r = 0; r < copies.size(); r++) {
+        const Copy& c = copies[r];
+        if (!c.name.empty()) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << c.tid << ",\"args\":{\"name\":";
+            writeJsonString(out, c.name);
+            out << "}}";
+            first = false;
+        }
+        for (size_t i = 0; i < c.events.size(); i++) {
+            const TraceEvent& e = c.events[i];
+            // Chrome trace timestamps are microseconds
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeJsonString(out, e.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << c.tid
+                << ",\"ts\":" << (double)(e.start - origin) / 1000.0
+                << ",\"dur\":" << (double)(e.end - e.start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lightweight scoped CPU timers, exported as Chrome trace JSON
+// (open in chrome://tracing or https://ui.perfetto.dev).
+//
+//   void Scene::render(...) {
+//       TRACE_SCOPE("Scene::render");
+//       ...
+//
+// Every thread records into its own fixed-size ring buffer, so recording
+// takes no lock and old events are overwritten when the ring is full.
+// Names must be string literals (only the pointer is stored).
+//
+// Builds without OPENGLPRJ_TRACE compile TRACE_SCOPE to nothing. In trace
+// builds a scope costs one relaxed atomic load while recording is off.
+class Trace {
+public:
+    // Turning recording on starts a new session
+    static void setEnabled(bool enabled);
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Label for the calling thread in the trace viewer
+    static void setThreadName(const char* name);
+
+    // Writes the events of the latest session still held by the thread rings
+    static bool writeChromeJson(const std::string& path);
+
+    // Monotonic clock in nanoseconds (never 0)
+    static uint64_t nowNs();
+
+    // Appends a completed event to the calling thread's ring
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<uint64_t> s_sessionStart; // nowNs() when recording last turned on
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : m_name(name), m_start(Trace::enabled() ? Trace::nowNs() : 0) {}
+    ~TraceScope() {
+        if (m_start != 0) Trace::record(m_name, m_start, Trace::nowNs());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_start;
+};
+
+#ifdef OPENGLPRJ_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
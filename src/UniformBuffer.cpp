@@ -0,0 +1,51 @@
+#include "UniformBuffer.h"
+
+#include <glad/glad.h>
+#include <cstring>
+
+#include "Trace.h"
+
+UniformBuffer::~UniformBuffer()
+{
+    destroy();
+}
+
+void UniformBuffer::init(unsigned int binding, size_t size)
+{
+    destroy();
+    m_binding = binding;
+    m_contents.assign(size, 0);
+
+    glGenBuffers(1, &m_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    bind();
+}
+
+void UniformBuffer::destroy()
+{
+    if (m_id) glDeleteBuffers(1, &m_id);
+    m_id = 0;
+    m_contents.clear();
+    m_valid = false;
+}
+
+bool UniformBuffer::update(const void* data, size_t size)
+{
+    TRACE_SCOPE("UniformBuffer::update");
+    if (m_id == 0 || size > m_contents.size()) return false;
+    if (m_valid && std::memcmp(m_contents.data(), data, size) == 0) return false;
+
+    std::memcpy(m_contents.data(), data, size);
+    m_valid = true;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return true;
+}
+
+void UniformBuffer::bind() const
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_id);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Binding points of the shared uniform blocks; every program that declares a
+// block gets it attached to the same point (Shader::bindUniformBlock), so one
+// buffer feeds them all
+enum UniformBinding { FrameBinding = 0, MaterialBinding = 1 };
+
+// std140 mirror of the shaders' `Frame` block: written once per frame
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::vec4 lightPos;   // xyz
+    glm::vec4 lightColor; // rgb
+    glm::vec4 viewport;   // width, height, 1/width, 1/height
+    glm::vec4 time;       // x = scene time in seconds (renderFrame)
+    glm::vec4 bloom;      // x = bright pass threshold
+};
+
+// Materials the lighting shader's `Materials` block holds
+const int kMaxMaterials = 8;
+
+// std140 mirror of the `Materials` block (vec3/vec2 arrays pad to vec4 anyway)
+struct MaterialUniforms {
+    glm::vec4 tint[kMaxMaterials];  // rgb
+    glm::vec4 scale[kMaxMaterials]; // xy = triplanar UVs per world unit
+};
+
+// A GL uniform buffer attached to one binding point. update() keeps a copy of
+// what was last uploaded and skips the upload when nothing changed.
+class UniformBuffer {
+public:
+    UniformBuffer() = default;
+    ~UniformBuffer();
+
+    // Non-copyable (owns a GL buffer)
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void init(unsigned int binding, size_t size);
+    void destroy();
+
+    // Returns false if the contents were unchanged (nothing uploaded)
+    bool update(const void* data, size_t size);
+
+    // Re-attaches the buffer to its binding point
+    void bind() const;
+
+private:
+    unsigned int m_id = 0;
+    unsigned int m_binding = 0;
+    std::vector<unsigned char> m_contents;
+    bool m_valid = false; // m_contents matches the buffer
+};
@@ -0,0 +1,89 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+GLsizei vertexStride(VertexFormat format)
+{
+    switch (format) {
+    case VertexPosPackedNormal:     return (GLsizei)sizeof(PackedVertex);
+    case VertexHalfPosPackedNormal: return (GLsizei)sizeof(HalfPackedVertex);
+    default:                        return (GLsizei)(6 * sizeof(float));
+    }
+}
+
+void setVertexAttribs(VertexFormat format, size_t offset)
+{
+    const GLsizei stride = vertexStride(format);
+
+    switch (format) {
+    case VertexPosPackedNormal:
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(PackedVertex, pos)));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(offset + offsetof(PackedVertex, normal)));
+        break;
+    case VertexHalfPosPackedNormal:
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(HalfPackedVertex, pos)));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(offset + offsetof(HalfPackedVertex, normal)));
+        break;
+    default:
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + 3 * sizeof(float)));
+        break;
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+}
+
+uint32_t packNormal(const glm::vec3& n)
+{
+    const float c[3] = { n.x, n.y, n.z };
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++) {
+        int v = (int)std::floor(std::max(-1.0f, std::min(1.0f, c[i])) * 511.0f + 0.5f);
+        packed |= ((uint32_t)v & 0x3FFu) << (10 * i);
+    }
+    return packed;
+}
+
+uint16_t floatToHalf(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t absBits = bits & 0x7FFFFFFFu;
+
+    if (absBits >= 0x7F800000u) // inf / nan
+        return (uint16_t)(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u : 0u));
+    if (absBits >= 0x477FF000u) // rounds past the largest half
+        return (uint16_t)(sign | 0x7C00u);
+
+    if (absBits < 0x38800000u) { // half denormal (or zero)
+        if (absBits < 0x33000000u) return (uint16_t)sign;
+        const uint32_t mant = (absBits & 0x7FFFFFu) | 0x800000u;
+        const int shift = 126 - (int)(absBits >> 23); // 14..24
+        uint32_t h = mant >> shift;
+        const uint32_t rest = mant & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (h & 1u))) h++;
+        return (uint16_t)(sign | h);
+    }
+
+    // normal: rebias the exponent, round the 13 dropped mantissa bits
+    uint32_t h = (absBits - 0x38000000u) >> 13;
+    const uint32_t rest = absBits & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) h++;
+    return (uint16_t)(sign | h);
+}
+
+void packVertices(const float* posNormal, size_t count, std::vector<PackedVertex>& out)
+{
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const float* v = posNormal + i * 6;
+        out[i].pos[0] = v[0];
+        out[i].pos[1] = v[1];
+        out[i].pos[2] = v[2];
+        out[i].normal = packNormal(glm::vec3(v[3], v[4], v[5]));
+    }
+}
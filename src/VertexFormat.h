@@ -0,0 +1,41 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vertex layouts of the lit meshes. The lighting shader reads location 0 =
+// position and location 1 = normal; normals are GL_INT_2_10_10_10_REV packed
+// (the shader renormalizes them).
+enum VertexFormat {
+    VertexPosNormal,          // float pos + float normal, 24 bytes (PosNormal)
+    VertexPosPackedNormal,    // float pos + packed normal, 16 bytes (PackedVertex)
+    VertexHalfPosPackedNormal // half pos + packed normal, 12 bytes (HalfPackedVertex)
+};
+
+struct PackedVertex {
+    float    pos[3];
+    uint32_t normal;
+};
+
+// Half float positions: keep them small (relative to a mesh origin) so the
+// 11-bit mantissa is enough. pos[3] is padding.
+struct HalfPackedVertex {
+    uint16_t pos[4];
+    uint32_t normal;
+};
+
+GLsizei vertexStride(VertexFormat format);
+
+// Points locations 0 and 1 at the bound GL_ARRAY_BUFFER, `offset` bytes in,
+// and enables them
+void setVertexAttribs(VertexFormat format, size_t offset = 0);
+
+// Signed normalized 10:10:10:2 (w = 0)
+uint32_t packNormal(const glm::vec3& n);
+// IEEE half, round to nearest even
+uint16_t floatToHalf(float f);
+
+// Converts interleaved pos(3) + normal(3) floats
+void packVertices(const float* posNormal, size_t count, std::vector<PackedVertex>& out);
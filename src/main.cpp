@@ -8,13 +8,21 @@
 #include <iostream>
 #include "Shader.h"
 #include "Camera.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
 #include <string>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
+#include <cstdlib>
 #include "Scene.h"
+#include "HeadlessContext.h"
+#include "AsyncCapture.h"
+#include "ShotList.h"
+#include "GpuProfiler.h"
+#include "GLState.h"
+#include "Trace.h"
+#include "Renderer.h"
+#include <chrono>
 
 
 const unsigned int SCR_WIDTH = 1600;
@@ -24,11 +32,15 @@ int gFbWidth  = SCR_WIDTH;
 int gFbHeight = SCR_HEIGHT;
 
 
-unsigned int gFBO = 0;
-unsigned int gColorTex = 0;
-unsigned int gRBO = 0;
-
 Camera gCamera(glm::vec3(0,0,3), glm::vec3(0,1,0), -90.0f, 0.0f);
+AsyncCapture gCapture;
+GpuProfiler gGpuProfiler;
+// Scene, bloom and post passes; composites offscreen in headless mode
+Renderer gRenderer;
+// Set by F12 in processInput, captured once the frame has been drawn
+std::string gPendingScreenshot;
+// ".png" or ".qoi" (fast lossless, for intermediate frames)
+std::string gCaptureExt = ".png";
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -48,9 +60,6 @@ bool  bloomEnabled = true;
 float bloomThreshold = 0.3f;   
 float bloomStrength  = 1.8f;   
 
-unsigned int gBrightTex = 0;
-unsigned int pingpongFBO[2] = {0,0};
-unsigned int pingpongTex[2] = {0,0};
 bool bPressedLastFrame = false;
 
 bool lPressedLastFrame = false;
@@ -82,212 +91,250 @@ void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
-
-// Shader sources
-const char* vertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
-
-out vec3 FragPos;
-out vec3 Normal;
-out vec3 vWorldPos;
-
-void main() {
-    FragPos = vec3(uModel * vec4(aPos, 1.0));
-    Normal  = mat3(transpose(inverse(uModel))) * aNormal;
-    vWorldPos = FragPos;
-
-    gl_Position = uProj * uView * vec4(FragPos, 1.0);
-})";
-
-const char* fragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-
-in vec3 FragPos;
-in vec3 Normal;
-in vec3 vWorldPos;
-
-uniform vec3 uLightPos;
-uniform vec3 uLightColor;
-uniform vec3 uObjectColor;
-uniform sampler2D uTex;
-uniform int uUseTexture;
-uniform vec2 uTexScale;
-
-vec3 TriplanarTex(sampler2D tex, vec3 worldPos, vec3 worldNormal, vec2 scale)
+// Headless runs advance the light animation with a fixed step instead of wall time
+const float kHeadlessTimeStep = 1.0f / 60.0f;
+
+struct CommandLine {
+    bool headless = false;
+    int  frames = 1;
+    int  width  = SCR_WIDTH;
+    int  height = SCR_HEIGHT;
+    std::string output = "render.png";
+    std::string shotList;
+    std::string outputDir = ".";
+    std::string gpuProfileCsv;
+    std::string traceFile;
+    bool gpuTerrain = false;
+    bool textureCache = true;
+    bool compressTextures = false;
+    bool shaderCache = true;
+    bool computePost = false;
+};
+
+void printUsage(const char* exe)
 {
-    vec3 n = normalize(worldNormal);
-    vec3 w = abs(n);
-    // sharpen blend a bit so it doesn't look muddy
-    w = pow(w, vec3(4.0));
-    w /= (w.x + w.y + w.z);
-
-    vec2 uvX = worldPos.zy * scale; // projection onto YZ (for X-facing)
-    vec2 uvY = worldPos.xz * scale; // projection onto XZ (for Y-facing)
-    vec2 uvZ = worldPos.xy * scale; // projection onto XY (for Z-facing)
-
-    vec3 x = texture(tex, uvX).rgb;
-    vec3 y = texture(tex, uvY).rgb;
-    vec3 z = texture(tex, uvZ).rgb;
-
-    return x * w.x + y * w.y + z * w.z;
-}
-
-void main() {
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(uLightPos - FragPos);
-
-    float diff = max(dot(norm, lightDir), 0.0);
-
-    vec3 ambient = 0.15 * uLightColor;
-    vec3 diffuse = diff * uLightColor;
-
-    vec3 baseColor = uObjectColor;
-
-    if (uUseTexture == 1) {
-    vec3 texColor = TriplanarTex(uTex, vWorldPos, Normal, uTexScale);
-    baseColor = texColor * uObjectColor;
+    std::cout << "Usage: " << exe << " [options]\n"
+              << "  --headless         render offscreen (EGL), no window or display needed\n"
+              << "  --frames N         number of frames to render in headless mode (default 1)\n"
+              << "  --width W          framebuffer width  (default " << SCR_WIDTH << ")\n"
+              << "  --height H         framebuffer height (default " << SCR_HEIGHT << ")\n"
+              << "  --output PATH      headless output PNG. One %d or %0Nd frame number, as in\n"
+              << "                     out_%04d.png, writes every frame, otherwise only the last\n"
+              << "                     (%% for a literal %)\n"
+              << "  --shots FILE       render every shot of a shot list and exit (see ShotList.h)\n"
+              << "  --output-dir DIR   where shot list renders go, as <shot name>.png (default .)\n"
+              << "  --capture-format F png (default) or qoi for F12 and shot list captures\n"
+              << "  --gpu-profile CSV  write per-pass GPU times (frame,pass,gpu_ms) to CSV\n"
+              << "  --trace JSON       record CPU trace scopes from startup, write Chrome trace at exit\n"
+              << "                     (F11 starts/stops recording interactively)\n"
+              << "  --gpu-terrain      displace terrain from a height texture in the vertex shader\n"
+              << "  --no-texture-cache decode textures every launch instead of using texture_cache/\n"
+              << "  --compress-textures BC1-compress textures (cached separately from RGBA8)\n"
+              << "  --no-shader-cache  compile shaders every launch instead of using shader_cache/\n"
+              << "  --compute-post     bloom and grading as compute kernels (needs GL 4.3)\n";
 }
 
+// Expands --output: %d or %0Nd becomes the frame number, %% a literal %.
+// Returns how many frame numbers the pattern has, or -1 if it uses % any
+// other way.
+int expandOutputPattern(const std::string& pattern, int frame, std::string& out)
+{
+    out.clear();
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            out += pattern[i];
+            continue;
+        }
+        size_t j = i + 1;
+        if (j < pattern.size() && pattern[j] == '%') {
+            out += '%';
+            i = j;
+            continue;
+        }
+        const bool zeroPad = j < pattern.size() && pattern[j] == '0';
+        if (zeroPad) j++;
+        int width = 0;
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') {
+            width = width * 10 + (pattern[j++] - '0');
+            if (width > 16) return -1;
+        }
+        if (j >= pattern.size() || pattern[j] != 'd') return -1;
 
-    vec3 result = (ambient + diffuse) * baseColor;
-    FragColor = vec4(result, 1.0);
-})";
-
-const char* ppVertexShaderSrc = R"(
-#version 330 core
-layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aUV;
-
-out vec2 vUV;
-
-void main() {
-    vUV = aUV;
-    gl_Position = vec4(aPos, 0.0, 1.0);
+        std::string digits = std::to_string(frame);
+        if ((int)digits.size() < width) digits.insert(0, width - digits.size(), zeroPad ? '0' : ' ');
+        out += digits;
+        conversions++;
+        i = j;
+    }
+    return conversions;
 }
-)";
-
-const char* ppFragmentShaderSrc = R"(
-#version 330 core
-out vec4 FragColor;
-in vec2 vUV;
-
-uniform sampler2D uScene;
-
-uniform float uBrightness; 
-uniform float uContrast;   
-uniform float uExposure;   
-uniform float uSaturation; 
-uniform float uVignette;   
-uniform float uVignetteSoftness; 
-uniform sampler2D uBloom;
-uniform float uBloomStrength;
-uniform bool  uBloomEnabled;
-
-
-void main() {
-    vec3 color = texture(uScene, vUV).rgb;
-
-    // --- exposure (photographic) ---
-    // exposure in "stops": +1 doubles brightness, -1 halves
-    color *= exp2(uExposure);
-
-    // --- brightness ---
-    color += vec3(uBrightness);
-
-    // --- contrast (pivot around 0.5) ---
-    color = (color - 0.5) * uContrast + 0.5;
-
-    // --- saturation ---
-    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
-    vec3 gray = vec3(luma);
-    color = mix(gray, color, uSaturation);
-
-    // --- vignette ---
-    vec2 center = vec2(0.5, 0.5);
-    float dist = distance(vUV, center); // 0 at center, ~0.707 at corner
-    // smooth darkening curve
-    float vig = smoothstep(0.707 - uVignetteSoftness, 0.707, dist);
-    color *= (1.0 - uVignette * vig);
 
+bool parseCommandLine(int argc, char** argv, CommandLine& cl)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--headless") {
+            cl.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            cl.frames = std::atoi(argv[++i]);
+        } else if (arg == "--width" && hasValue) {
+            cl.width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            cl.height = std::atoi(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            cl.output = argv[++i];
+        } else if (arg == "--shots" && hasValue) {
+            cl.shotList = argv[++i];
+        } else if (arg == "--output-dir" && hasValue) {
+            cl.outputDir = argv[++i];
+        } else if (arg == "--capture-format" && hasValue) {
+            std::string fmt = argv[++i];
+            if (fmt != "png" && fmt != "qoi") {
+                std::cerr << "--capture-format must be png or qoi\n";
+                return false;
+            }
+            gCaptureExt = "." + fmt;
+        } else if (arg == "--gpu-profile" && hasValue) {
+            cl.gpuProfileCsv = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            cl.traceFile = argv[++i];
+        } else if (arg == "--gpu-terrain") {
+            cl.gpuTerrain = true;
+        } else if (arg == "--no-texture-cache") {
+            cl.textureCache = false;
+        } else if (arg == "--compress-textures") {
+            cl.compressTextures = true;
+        } else if (arg == "--no-shader-cache") {
+            cl.shaderCache = false;
+        } else if (arg == "--compute-post") {
+            cl.computePost = true;
+        } else {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return false;
+        }
+    }
 
-    if (uBloomEnabled) {
-    vec3 bloom = texture(uBloom, vUV).rgb;
-    color += bloom * uBloomStrength;
+    if (cl.frames < 1 || cl.width < 1 || cl.height < 1) {
+        std::cerr << "--frames, --width and --height must be positive\n";
+        return false;
     }
-    FragColor = vec4(color, 1.0);
+    std::string expanded;
+    const int conversions = expandOutputPattern(cl.output, 0, expanded);
+    if (conversions < 0 || conversions > 1) {
+        std::cerr << "--output may hold one %d or %0Nd frame number; write %% for a literal %\n";
+        return false;
+    }
+    return true;
 }
-)";
-
 
-const char* brightFragSrc = R"(
-#version 330 core
-out vec4 FragColor;
-in vec2 vUV;
-
-uniform sampler2D uScene;
-uniform float uThreshold;
-
-void main() {
-    vec3 c = texture(uScene, vUV).rgb;
-    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));
-    vec3 outC = (luma > uThreshold) ? c : vec3(0.0);
-    FragColor = vec4(outC, 1.0);
+// Snapshot of the interactive state, used as the base for the first shot
+Shot currentShot()
+{
+    Shot shot;
+    shot.position = gCamera.position();
+    shot.yaw   = gCamera.yaw();
+    shot.pitch = gCamera.pitch();
+    shot.fov   = gCamera.fov();
+
+    shot.lightSnapMode    = lightSnapMode;
+    shot.lightSnapSteps   = lightSnapSteps;
+    shot.lightSnapIndex   = lightSnapIndex;
+    shot.lightAngle       = glm::degrees(lightAngle);
+    shot.lightOrbitRadius = lightOrbitRadius;
+    shot.lightHeight      = lightHeight;
+
+    shot.brightness       = brightness;
+    shot.contrast         = contrast;
+    shot.exposure         = exposure;
+    shot.saturation       = saturation;
+    shot.vignette         = vignette;
+    shot.vignetteSoftness = vignetteSoftness;
+    shot.bloomEnabled     = bloomEnabled;
+    shot.bloomThreshold   = bloomThreshold;
+    shot.bloomStrength    = bloomStrength;
+    return shot;
 }
-)";
-
-const char* blurFragSrc = R"(
-#version 330 core
-out vec4 FragColor;
-in vec2 vUV;
-
-uniform sampler2D uImage;
-uniform bool uHorizontal;
-uniform vec2 uTexelSize; // 1/width, 1/height
 
-void main() {
-    // 5-tap gaussian (small + fast)
-    float w0 = 0.227027;
-    float w1 = 0.1945946;
-    float w2 = 0.1216216;
-
-    vec2 off = uHorizontal ? vec2(uTexelSize.x, 0.0) : vec2(0.0, uTexelSize.y);
-
-    vec3 result = texture(uImage, vUV).rgb * w0;
-    result += texture(uImage, vUV + off * 1.0).rgb * w1;
-    result += texture(uImage, vUV - off * 1.0).rgb * w1;
-    result += texture(uImage, vUV + off * 2.0).rgb * w2;
-    result += texture(uImage, vUV - off * 2.0).rgb * w2;
-
-    FragColor = vec4(result, 1.0);
+void applyShot(const Shot& shot)
+{
+    gCamera.setPose(shot.position, shot.yaw, shot.pitch);
+    gCamera.setFov(shot.fov);
+
+    // scripted shots must not drift with the orbit animation
+    lightAnimate     = false;
+    lightSnapMode    = shot.lightSnapMode;
+    lightSnapSteps   = shot.lightSnapSteps;
+    lightSnapIndex   = ((shot.lightSnapIndex % lightSnapSteps) + lightSnapSteps) % lightSnapSteps;
+    lightAngle       = glm::radians(shot.lightAngle);
+    lightOrbitRadius = shot.lightOrbitRadius;
+    lightHeight      = shot.lightHeight;
+
+    brightness       = shot.brightness;
+    contrast         = shot.contrast;
+    exposure         = shot.exposure;
+    saturation       = shot.saturation;
+    vignette         = shot.vignette;
+    vignetteSoftness = shot.vignetteSoftness;
+    bloomEnabled     = shot.bloomEnabled;
+    bloomThreshold   = shot.bloomThreshold;
+    bloomStrength    = shot.bloomStrength;
 }
-)";
 
-void takeScreenshot(const std::string& filename, int width, int height)
+// Returns the file name for a headless frame, or "" if that frame isn't saved.
+std::string headlessOutputPath(const CommandLine& cl, int frame)
 {
-    std::vector<unsigned char> pixels(width * height * 3);
+    std::string path;
+    if (expandOutputPattern(cl.output, frame, path) == 0 && frame != cl.frames - 1) return std::string();
+    return path;
+}
 
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
 
-    for (int y = 0; y < height / 2; y++) {
-        for (int x = 0; x < width * 3; x++) {
-            std::swap(
-                pixels[y * width * 3 + x],
-                pixels[(height - 1 - y) * width * 3 + x]
-            );
-        }
+// Advances the light orbit by deltaTime and returns the light position
+glm::vec3 updateLightPosition()
+{
+    if (lightSnapMode) {
+        const float step = glm::two_pi<float>() / (float)lightSnapSteps;
+        float ang = (float)lightSnapIndex * step;
+
+        return glm::vec3(
+            cos(ang) * lightOrbitRadius,
+            lightHeight,
+            sin(ang) * lightOrbitRadius
+        );
+    }
+    if (lightAnimate) {
+        lightAngle += lightOrbitSpeed * deltaTime;
     }
+    return glm::vec3(
+        cos(lightAngle) * lightOrbitRadius,
+        lightHeight,
+        sin(lightAngle) * lightOrbitRadius
+    );
+}
 
-    stbi_write_png(filename.c_str(), width, height, 3, pixels.data(), width * 3);
+PostSettings currentPostSettings()
+{
+    PostSettings post;
+    post.brightness       = brightness;
+    post.contrast         = contrast;
+    post.exposure         = exposure;
+    post.saturation       = saturation;
+    post.vignette         = vignette;
+    post.vignetteSoftness = vignetteSoftness;
+    post.bloomEnabled     = bloomEnabled;
+    post.bloomThreshold   = bloomThreshold;
+    post.bloomStrength    = bloomStrength;
+    return post;
+}
 
-    std::cout << "Screenshot saved: " << filename << "\n";
+// Reads the bound framebuffer asynchronously; the PNG is written by gCapture's
+// worker a frame or two later.
+void takeScreenshot(const std::string& filename, int width, int height)
+{
+    gCapture.request(filename, width, height);
 }
 
 
@@ -305,308 +352,130 @@ void ensureScreenshotFolderExists()
 
 
 
-void recreateFramebufferAttachments(int width, int height) {
-    gFbWidth = width;
-    gFbHeight = height;
-
-    // Resize color texture
-    glBindTexture(GL_TEXTURE_2D, gColorTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-
-    // Resize depth-stencil renderbuffer
-    glBindRenderbuffer(GL_RENDERBUFFER, gRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-
-    if (gBrightTex != 0) {
-        glBindTexture(GL_TEXTURE_2D, gBrightTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
+int main(int argc, char** argv) {
+    CommandLine cl;
+    if (!parseCommandLine(argc, argv, cl)) {
+        printUsage(argv[0]);
+        return -1;
     }
-
-    for (int i = 0; i < 2; i++) {
-        if (pingpongTex[i] != 0) {
-            glBindTexture(GL_TEXTURE_2D, pingpongTex[i]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    Trace::setThreadName("main");
+    if (!cl.traceFile.empty()) Trace::setEnabled(true);
+
+    const bool headless = cl.headless;
+    gFbWidth  = cl.width;
+    gFbHeight = cl.height;
+
+    std::vector<Shot> shots;
+    if (!cl.shotList.empty()) {
+        std::string error;
+        if (!loadShotList(cl.shotList, currentShot(), shots, error)) {
+            std::cerr << "Shot list: " << error << "\n";
+            return -1;
         }
     }
-    
-    glBindFramebuffer(GL_FRAMEBUFFER, gFBO);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "ERROR: Framebuffer not complete after resize!\n";
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
 
+    GLFWwindow* window = nullptr;
+    HeadlessContext headlessContext;
 
-
-int main() {
-    // GLFW and OpenGL setup
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Manual Aperture Blades", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
-        return -1;
-    }
+    if (headless) {
+        // No window, no display: offscreen EGL context, the renderer composites into its own target
+        // 4.3 for the compute post path, else 3.3 is all that's needed
+        if (!(cl.computePost && headlessContext.create(4, 3)) && !headlessContext.create(3, 3)) {
+            std::cerr << "Failed to create headless OpenGL context\n";
+            return -1;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            return -1;
+        }
+    } else {
+        // GLFW and OpenGL setup
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, cl.computePost ? 4 : 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(cl.width, cl.height, "Manual Aperture Blades", nullptr, nullptr);
+        if (!window && cl.computePost) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            window = glfwCreateWindow(cl.width, cl.height, "Manual Aperture Blades", nullptr, nullptr);
+        }
+        if (!window) {
+            std::cerr << "Failed to create GLFW window\n";
+            glfwTerminate();
+            return -1;
+        }
 
 
-    glfwMakeContextCurrent(window);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    mouseCaptured = true;
-    gCamera.setMouseSensitivity(0.1f);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize GLAD\n";
-        return -1;
+        glfwMakeContextCurrent(window);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        mouseCaptured = true;
+        gCamera.setMouseSensitivity(0.1f);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            return -1;
+        }
+        glfwGetFramebufferSize(window, &gFbWidth, &gFbHeight);
     }
     // ENABLE DEPTH TESTING (3D rendering)
     glEnable(GL_DEPTH_TEST);
 
-    // Compile shaders
-    Shader lightingShader(vertexShaderSource, fragmentShaderSource);
     ensureScreenshotFolderExists();
     Scene scene;
-    scene.init();
-
-
-
-
-    // ----- Compile post-process shader program -----
-    Shader postShader(ppVertexShaderSrc, ppFragmentShaderSrc);
-    postShader.use();
-    postShader.setInt("uScene", 0); // texture unit 0 once
-    Shader brightShader(ppVertexShaderSrc, brightFragSrc);
-    brightShader.use();
-    brightShader.setInt("uScene", 0);
-
-    Shader blurShader(ppVertexShaderSrc, blurFragSrc);
-    blurShader.use();
-    blurShader.setInt("uImage", 0);
-
-
-
-    //for the birghtness and contrast
-    glGenFramebuffers(1, &gFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, gFBO);
-
-    // color texture
-    glGenTextures(1, &gColorTex);
-    glBindTexture(GL_TEXTURE_2D, gColorTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gColorTex, 0);
-
-    // depth + stencil
-    glGenRenderbuffers(1, &gRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, gRBO);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, gRBO);
-
-    // allocate initial storage using current framebuffer size
-    recreateFramebufferAttachments(SCR_WIDTH, SCR_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    //BLOOM
-    unsigned int brightFBO = 0;
-    glGenFramebuffers(1, &brightFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, brightFBO);
-    glViewport(0, 0, gFbWidth, gFbHeight);
-
-    glGenTextures(1, &gBrightTex);
-    glBindTexture(GL_TEXTURE_2D, gBrightTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, gFbWidth, gFbHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBrightTex, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
+    SceneSettings sceneSettings;
+    sceneSettings.terrain.gpuDisplacement = cl.gpuTerrain;
+    sceneSettings.textureCache = cl.textureCache;
+    sceneSettings.compressTextures = cl.compressTextures;
+    scene.init(sceneSettings);
+    gCapture.init();
+    gGpuProfiler.init();
+    if (!cl.gpuProfileCsv.empty() && !gGpuProfiler.openCsv(cl.gpuProfileCsv)) {
+        std::cerr << "Cannot write GPU profile to " << cl.gpuProfileCsv << "\n";
+    }
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "ERROR: Bright FBO incomplete!\n";
+    const std::string shaderCacheDir = cl.shaderCache ? std::string(PROJECT_SOURCE_DIR) + "/shader_cache" : std::string();
+    if (!gRenderer.init(gFbWidth, gFbHeight, headless, shaderCacheDir)) {
+        std::cerr << "Failed to create render targets\n";
+        return -1;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    GLenum db = GL_COLOR_ATTACHMENT0;
-    glDrawBuffers(1, &db);
-
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongTex);
-
-    for (int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        GLenum db = GL_COLOR_ATTACHMENT0;
-        glDrawBuffers(1, &db);
-        glBindTexture(GL_TEXTURE_2D, pingpongTex[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, gFbWidth, gFbHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongTex[i], 0);
-
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            std::cout << "ERROR: Pingpong FBO " << i << " incomplete!\n";
-        }
+    if (cl.computePost && !gRenderer.enableComputePost(ComputePostSettings())) {
+        std::cerr << "Compute post needs OpenGL 4.3, using the fragment path\n";
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-
-    float quadVertices[] = {
-        // positions   // uvs
-        -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f, 1.0f,
-
-         1.0f,  1.0f,  1.0f, 1.0f,
-        -1.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  0.0f, 0.0f
-    };
-
-    unsigned int quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
+    const ShaderCache::Stats& shaderStats = gRenderer.shaderStats();
+    std::cout << "shaders: " << shaderStats.hits << " cached, " << shaderStats.misses << " compiled in "
+              << shaderStats.ms << " ms\n";
 
+    // Headless and shot list runs render a fixed number of frames, then exit
+    const bool batch = headless || !shots.empty();
+    // and their images must not show placeholder textures
+    if (batch) scene.finishLoading();
+    const int batchFrames = shots.empty() ? cl.frames : (int)shots.size();
+    std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
 
     // --- Render Loop ---
-    while (!glfwWindowShouldClose(window)) {
-
-        float currentFrame = (float)glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        processInput(window);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, gFBO);
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.55f, 0.75f, 0.95f, 1.0f); // sky blue
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // use your lighting shader and draw floor + cubes (your existing code)
-
-        lightingShader.use();
-
-        // ----- COMMON MATRICES -----
-        glm::mat4 view = gCamera.getViewMatrix();
-        glm::mat4 proj = glm::perspective(glm::radians(gCamera.fov()), (float)gFbWidth / (float)gFbHeight, 0.1f, 100.0f);
-
-        lightingShader.setMat4("uView", view);
-        lightingShader.setMat4("uProj", proj);
-
-        // ----- LIGHT (common to all objects) -----
-        glm::vec3 lightPos;
-        if (lightSnapMode) {
-            const float step = glm::two_pi<float>() / (float)lightSnapSteps;
-            float ang = (float)lightSnapIndex * step;
-
-            lightPos = glm::vec3(
-                cos(ang) * lightOrbitRadius,
-                lightHeight,
-                sin(ang) * lightOrbitRadius
-            );
+    int frame = 0;
+    float sceneTime = 0.0f; // sum of deltaTime: fixed steps in batch runs
+    while (batch ? (frame < batchFrames && !(window && glfwWindowShouldClose(window)))
+                 : !glfwWindowShouldClose(window)) {
+        TRACE_SCOPE("frame");
+
+        if (batch) {
+            deltaTime = kHeadlessTimeStep;
+            if (!shots.empty()) applyShot(shots[frame]);
         } else {
-            if (lightAnimate) {
-                lightAngle += lightOrbitSpeed * deltaTime;
-            }
+            float currentFrame = (float)glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
 
-            lightPos = glm::vec3(
-                cos(lightAngle) * lightOrbitRadius,
-                lightHeight,
-                sin(lightAngle) * lightOrbitRadius
-            );
+            processInput(window);
         }
-        scene.render(lightingShader, view, proj, lightPos);
-        lightingShader.setVec3("uLightPos", lightPos);
-        lightingShader.setVec3("uLightColor", glm::vec3(1.0f));
-
-
-        glBindFramebuffer(GL_FRAMEBUFFER, brightFBO);
-        glViewport(0, 0, gFbWidth, gFbHeight);
-        glDisable(GL_DEPTH_TEST);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        brightShader.use();
-        brightShader.setFloat("uThreshold", bloomThreshold);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gColorTex);
-
-        glBindVertexArray(quadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        bool horizontal = true;
-        bool firstIteration = true;
-        int blurPasses = 10;
-
-        blurShader.use();
-        blurShader.setVec2("uTexelSize", glm::vec2(1.0f / gFbWidth, 1.0f / gFbHeight));
-
-        for (int i = 0; i < blurPasses; i++) {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal ? 0 : 1]);
-            blurShader.setInt("uHorizontal", horizontal ? 1 : 0);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, firstIteration ? gBrightTex : pingpongTex[horizontal ? 1 : 0]);
-
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-            horizontal = !horizontal;
-            firstIteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // final blurred result:
-        unsigned int blurredBloomTex = pingpongTex[horizontal ? 1 : 0];
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST);
-        glClearColor(0,0,0,1);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        postShader.use();
-
-        // post params
-        postShader.setFloat("uBrightness", brightness);
-        postShader.setFloat("uContrast", contrast);
-        postShader.setFloat("uExposure", exposure);
-        postShader.setFloat("uSaturation", saturation);
-        postShader.setFloat("uVignette", vignette);
-        postShader.setFloat("uVignetteSoftness", vignetteSoftness);
-
-        // bloom params
-        postShader.setInt("uScene", 0);
-        postShader.setInt("uBloom", 1);
-        postShader.setFloat("uBloomStrength", bloomStrength);
-        postShader.setInt("uBloomEnabled", bloomEnabled ? 1 : 0);
 
-
-        // textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gColorTex);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, blurredBloomTex);
-
-        glBindVertexArray(quadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        gGpuProfiler.beginFrame();
+        sceneTime += deltaTime;
+        gRenderer.renderFrame(scene, gCamera, updateLightPosition(), sceneTime, currentPostSettings(), &gGpuProfiler);
+        gGpuProfiler.endFrame();
 
 
 
@@ -628,20 +497,75 @@ int main() {
                          << "thresh hold= " << bloomThreshold
                             <<"bloom strenght= "<< bloomStrength
                           << "\n";
+                gGpuProfiler.print(std::cout);
+                const CullGrid::Stats& cull = scene.cullStats();
+                std::cout << "instances visible=" << cull.visible << " culled=" << cull.culled
+                          << " cells tested=" << cull.cellsVisited << "\n";
+                const Terrain::Stats& terrain = scene.terrainStats();
+                std::cout << "terrain chunks drawn=" << terrain.chunksDrawn << " culled=" << terrain.chunksCulled
+                          << " built=" << terrain.chunksBuilt << " cached=" << terrain.chunksCached << "\n";
+                // since the last print
+                GLState::print(std::cout);
+                GLState::resetCounters();
+            }
+        }
+
+
+        // Captures are asynchronous: this frame is read back and encoded while
+        // the next shot renders.
+        if (!shots.empty()) {
+            takeScreenshot(cl.outputDir + "/" + shots[frame].name + gCaptureExt, gFbWidth, gFbHeight);
+        } else if (headless) {
+            std::string path = headlessOutputPath(cl, frame);
+            if (!path.empty()) {
+                takeScreenshot(path, gFbWidth, gFbHeight);
             }
+        } else if (!gPendingScreenshot.empty()) {
+            // capture the finished frame before it is swapped away
+            takeScreenshot(gPendingScreenshot, gFbWidth, gFbHeight);
+            gPendingScreenshot.clear();
         }
+        gCapture.poll();
 
+        if (!headless) {
+            TRACE_SCOPE("swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        frame++;
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    gCapture.destroy(); // writes out captures still in flight
+    gGpuProfiler.flush();
+    if (!cl.gpuProfileCsv.empty()) {
+        gGpuProfiler.print(std::cout);
     }
+    gGpuProfiler.destroy();
 
+    if (!cl.traceFile.empty()) {
+        if (Trace::writeChromeJson(cl.traceFile))
+            std::cout << "Trace written: " << cl.traceFile << "\n";
+        else
+            std::cerr << "Failed to write trace: " << cl.traceFile << "\n";
+    }
+
+    if (!shots.empty()) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+        std::cout << "Rendered " << frame << " shots in " << seconds << " s ("
+                  << (seconds > 0.0 ? frame / seconds : 0.0) << " shots/s)\n";
+    }
     scene.destroy();
-    glfwTerminate();
+    gRenderer.destroy();
+    if (headless) {
+        headlessContext.destroy();
+    } else {
+        glfwTerminate();
+    }
     return 0;
 }
 
 void processInput(GLFWwindow *window) {
+    TRACE_SCOPE("processInput");
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
@@ -795,13 +719,35 @@ void processInput(GLFWwindow *window) {
            << "/src/Screenshots/screenshot_"
            << std::setw(4) << std::setfill('0')
            << (int)glfwGetTime()
-           << ".png";
+           << gCaptureExt;
 
-        takeScreenshot(ss.str(), gFbWidth, gFbHeight);
+        gPendingScreenshot = ss.str();
     }
 
     screenshotPressedLastFrame = screenshotPressed;
 
+    // F11: start recording a CPU trace, press again to write it out
+    static bool tracePressedLastFrame = false;
+    bool tracePressed = glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS;
+    if (tracePressed && !tracePressedLastFrame)
+    {
+        if (!Trace::enabled()) {
+            Trace::setEnabled(true);
+            std::cout << "Trace recording started (F11 again to save)\n";
+        } else {
+            Trace::setEnabled(false);
+            std::ostringstream ss;
+            ss << PROJECT_SOURCE_DIR
+               << "/src/Screenshots/trace_"
+               << std::setw(4) << std::setfill('0')
+               << (int)glfwGetTime()
+               << ".json";
+            if (Trace::writeChromeJson(ss.str()))
+                std::cout << "Trace saved: " << ss.str() << "\n";
+        }
+    }
+    tracePressedLastFrame = tracePressed;
+
 }
 
 
@@ -810,8 +756,10 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 
     // Avoid zero-sized resize (can happen when minimizing)
-    if (width > 0 && height > 0 && gFBO != 0) {
-        recreateFramebufferAttachments(width, height);
+    if (width > 0 && height > 0) {
+        gFbWidth = width;
+        gFbHeight = height;
+        gRenderer.resize(width, height);
     }
 }
 
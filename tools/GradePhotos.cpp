@@ -0,0 +1,291 @@
+// Offline grading: applies the post shader's grading and bloom to images on
+// disk with CpuGrade, no GPU or GL context needed. The bloom is the compute
+// path's single Gaussian, not the app's default pyramid, so outputs match
+// renders made with --compute-post rather than the default ones.
+//
+//   OpenGLPrj_grade [options] --output-dir DIR image...
+//
+// Every image is split into tiles that run on all cores; images are done one
+// after another. Outputs are <output dir>/<input name>.png (or .qoi), RGB or
+// RGBA like the input; inputs from different directories with the same name
+// get _2, _3, ... appended in input order. --list FILE reads input paths from
+// a file, one per line, for batches too long for a command line.
+//
+// --check grades every image a second time one pixel at a time and reports
+// the largest difference to the vectorized result, in 8-bit steps; it fails
+// if any channel is off by more than one.
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "CpuGrade.h"
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+struct Options {
+    PostSettings post;
+    CpuGradeOptions grade;
+    std::vector<std::string> inputs;
+    std::string outputDir = ".";
+    std::string extension = ".png";
+    bool check = false;
+};
+
+void printUsage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " [options] image...\n"
+              << "  --output-dir DIR       where graded images go, created if missing (default .)\n"
+              << "  --list FILE            also grade every path listed in FILE, one per line\n"
+              << "  --format F             png (default) or qoi\n"
+              << "  --exposure STOPS       (default 0)\n"
+              << "  --brightness B         (default 0)\n"
+              << "  --contrast C           (default 1)\n"
+              << "  --saturation S         (default 1)\n"
+              << "  --vignette V           (default 0)\n"
+              << "  --vignette-softness S  (default 0.35)\n"
+              << "  --bloom-threshold T    luminance above which pixels bloom (default 0.3)\n"
+              << "  --bloom-strength S     (default 1.8)\n"
+              << "  --bloom-radius R       blur taps each side at half resolution (default 16)\n"
+              << "  --no-bloom             grading only\n"
+              << "  --threads N            worker threads (default: every core)\n"
+              << "  --scalar               one pixel at a time instead of " << gradeSimdName() << "\n"
+              << "  --check                compare against the scalar path, fail beyond 1/255\n";
+}
+
+bool readList(const std::string& path, std::vector<std::string>& inputs)
+{
+    std::ifstream file(path.c_str());
+    if (!file.is_open()) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (!line.empty()) inputs.push_back(line);
+    }
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if (arg == "--output-dir" && hasValue) {
+            opt.outputDir = argv[++i];
+        } else if (arg == "--list" && hasValue) {
+            std::string list = argv[++i];
+            if (!readList(list, opt.inputs)) {
+                std::cerr << "Cannot read " << list << "\n";
+                return false;
+            }
+        } else if (arg == "--format" && hasValue) {
+            std::string fmt = argv[++i];
+            if (fmt != "png" && fmt != "qoi") {
+                std::cerr << "--format must be png or qoi\n";
+                return false;
+            }
+            opt.extension = "." + fmt;
+        } else if (arg == "--exposure" && hasValue) {
+            opt.post.exposure = (float)std::atof(argv[++i]);
+        } else if (arg == "--brightness" && hasValue) {
+            opt.post.brightness = (float)std::atof(argv[++i]);
+        } else if (arg == "--contrast" && hasValue) {
+            opt.post.contrast = (float)std::atof(argv[++i]);
+        } else if (arg == "--saturation" && hasValue) {
+            opt.post.saturation = (float)std::atof(argv[++i]);
+        } else if (arg == "--vignette" && hasValue) {
+            opt.post.vignette = (float)std::atof(argv[++i]);
+        } else if (arg == "--vignette-softness" && hasValue) {
+            opt.post.vignetteSoftness = (float)std::atof(argv[++i]);
+        } else if (arg == "--bloom-threshold" && hasValue) {
+            opt.post.bloomThreshold = (float)std::atof(argv[++i]);
+        } else if (arg == "--bloom-strength" && hasValue) {
+            opt.post.bloomStrength = (float)std::atof(argv[++i]);
+        } else if (arg == "--bloom-radius" && hasValue) {
+            opt.grade.bloomRadius = std::atoi(argv[++i]);
+        } else if (arg == "--no-bloom") {
+            opt.post.bloomEnabled = false;
+        } else if (arg == "--threads" && hasValue) {
+            opt.grade.threads = std::atoi(argv[++i]);
+        } else if (arg == "--scalar") {
+            opt.grade.simd = false;
+        } else if (arg == "--check") {
+            opt.check = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            opt.inputs.push_back(arg);
+        } else {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return false;
+        }
+    }
+    if (opt.inputs.empty()) {
+        std::cerr << "No input images\n";
+        return false;
+    }
+    if (opt.grade.bloomRadius < 1) {
+        std::cerr << "--bloom-radius must be positive\n";
+        return false;
+    }
+    return true;
+}
+
+// "dir/photo.jpg" -> "photo"
+std::string stem(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+// Output file names (without extension), one per input: the stem, or the stem
+// plus _2, _3, ... when several inputs share it, never reusing another's name
+std::vector<std::string> outputNames(const std::vector<std::string>& inputs)
+{
+    std::map<std::string, int> stemCount;
+    for (size_t i = 0; i < inputs.size(); i++) stemCount[stem(inputs[i])]++;
+
+    std::set<std::string> used;
+    std::map<std::string, int> nextSuffix;
+    std::vector<std::string> names(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const std::string base = stem(inputs[i]);
+        std::string name = base;
+        if (used.count(name)) {
+            int& suffix = nextSuffix[base];
+            if (suffix < 2) suffix = 2;
+            do {
+                name = base + "_" + std::to_string(suffix++);
+            } while (used.count(name) || stemCount.count(name));
+        }
+        used.insert(name);
+        names[i] = name;
+    }
+    return names;
+}
+
+bool makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0777);
+#endif
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+int maxDifference(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b)
+{
+    int diff = 0;
+    for (size_t i = 0; i < a.size(); i++) diff = std::max(diff, std::abs((int)a[i] - (int)b[i]));
+    return diff;
+}
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    if (!makeDirectory(opt.outputDir)) {
+        std::cerr << "Cannot create output directory " << opt.outputDir << "\n";
+        return -1;
+    }
+    const std::vector<std::string> names = outputNames(opt.inputs);
+
+    std::cout << "grading " << opt.inputs.size() << " image(s) with " << (opt.grade.simd ? gradeSimdName() : "scalar")
+              << " kernels\n";
+
+    int failed = 0;
+    int worstDifference = 0;
+    double gradeMs = 0.0;
+    double megapixels = 0.0;
+    std::vector<unsigned char> graded, reference;
+    for (size_t i = 0; i < opt.inputs.size(); i++) {
+        const std::string& input = opt.inputs[i];
+        int w = 0, h = 0, n = 0;
+        if (!stbi_info(input.c_str(), &w, &h, &n)) {
+            std::cerr << input << ": " << stbi_failure_reason() << "\n";
+            failed++;
+            continue;
+        }
+        // grey becomes RGB, anything with alpha RGBA
+        const int channels = (n == 2 || n == 4) ? 4 : 3;
+        unsigned char* pixels = stbi_load(input.c_str(), &w, &h, &n, channels);
+        if (!pixels) {
+            std::cerr << input << ": " << stbi_failure_reason() << "\n";
+            failed++;
+            continue;
+        }
+
+        ImageView image;
+        image.pixels = pixels;
+        image.width = w;
+        image.height = h;
+        image.channels = channels;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        gradeImage(image, opt.post, opt.grade, graded);
+        const double ms = msSince(start);
+        gradeMs += ms;
+        megapixels += (double)w * h / 1e6;
+
+        bool matches = true;
+        if (opt.check) {
+            CpuGradeOptions scalar = opt.grade;
+            scalar.simd = false;
+            gradeImage(image, opt.post, scalar, reference);
+            const int diff = maxDifference(graded, reference);
+            worstDifference = std::max(worstDifference, diff);
+            if (diff > 1) {
+                std::cerr << input << ": differs from the scalar path by " << diff << "/255\n";
+                matches = false;
+            }
+        }
+        stbi_image_free(pixels);
+
+        ImageView out;
+        out.pixels = graded.data();
+        out.width = w;
+        out.height = h;
+        out.channels = channels;
+        const std::string output = opt.outputDir + "/" + names[i] + opt.extension;
+        if (!writeImage(output, out, opt.grade.threads)) {
+            std::cerr << "Cannot write " << output << "\n";
+            failed++;
+            continue;
+        }
+        if (!matches) failed++;
+        std::cout << input << " -> " << output << " (" << w << "x" << h << ", " << ms << " ms)\n";
+    }
+
+    std::cout << "graded " << opt.inputs.size() - failed << "/" << opt.inputs.size() << " in " << gradeMs
+              << " ms (" << (gradeMs > 0.0 ? megapixels * 1000.0 / gradeMs : 0.0) << " MP/s)\n";
+    if (opt.check) std::cout << "largest difference to scalar: " << worstDifference << "/255\n";
+    return failed ? 1 : 0;
+}